@@ -0,0 +1,282 @@
+#include <cmath>
+#include <algorithm>
+#include "BarnesHut.h"
+#include "JobSystem.h"
+
+//Spreads the low 21 bits of v out so there are two zero bits between each
+static uint64_t expandBits(uint64_t v) {
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffULL;
+    v = (v | v << 16) & 0x1f0000ff0000ffULL;
+    v = (v | v << 8) & 0x100f00f00f00f00fULL;
+    v = (v | v << 4) & 0x10c30c30c30c30c3ULL;
+    v = (v | v << 2) & 0x1249249249249249ULL;
+    return v;
+}
+
+BarnesHut::BarnesHut(double theta, unsigned int leafCapacity) {
+    this->theta = theta;
+    this->leafCapacity = std::max(1u, leafCapacity);
+    rootSize = 0.0;
+}
+
+void BarnesHut::sortBodies(const double* x, const double* y, const double* z, unsigned int count) {
+    double minX = x[0], minY = y[0], minZ = z[0];
+    double maxX = x[0], maxY = y[0], maxZ = z[0];
+    for (unsigned int i = 1; i < count; ++i) {
+        minX = std::min(minX, x[i]); maxX = std::max(maxX, x[i]);
+        minY = std::min(minY, y[i]); maxY = std::max(maxY, y[i]);
+        minZ = std::min(minZ, z[i]); maxZ = std::max(maxZ, z[i]);
+    }
+    //The root is a cube so every cell stays a cube; pad slightly so the far edge maps inside the grid
+    rootSize = std::max(maxX - minX, std::max(maxY - minY, maxZ - minZ)) * 1.0001 + 1e-9;
+    double scale = (double)(1u << MAX_DEPTH) / rootSize;
+
+    keyed.resize(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        uint64_t cx = (uint64_t)((x[i] - minX) * scale);
+        uint64_t cy = (uint64_t)((y[i] - minY) * scale);
+        uint64_t cz = (uint64_t)((z[i] - minZ) * scale);
+        keyed[i] = { expandBits(cx) << 2 | expandBits(cy) << 1 | expandBits(cz), i };
+    }
+
+    //Sort one chunk per worker, then merge neighbouring chunks in rounds
+    unsigned int chunks = std::max(1u, std::min(JobSystem::getThreadCount(), count / 4096 + 1));
+    std::vector<unsigned int> bounds(chunks + 1);
+    for (unsigned int c = 0; c <= chunks; ++c) {
+        bounds[c] = (unsigned int)((uint64_t)count * c / chunks);
+    }
+    JobSystem::parallelFor(chunks, 1, [this, &bounds](unsigned int first, unsigned int last) {
+        for (unsigned int c = first; c < last; ++c) {
+            std::sort(keyed.begin() + bounds[c], keyed.begin() + bounds[c + 1]);
+        }
+    });
+    for (unsigned int width = 1; width < chunks; width *= 2) {
+        unsigned int merges = (chunks - width + 2 * width - 1) / (2 * width);
+        JobSystem::parallelFor(merges, 1, [this, &bounds, width, chunks](unsigned int first, unsigned int last) {
+            for (unsigned int m = first; m < last; ++m) {
+                unsigned int c = m * 2 * width;
+                unsigned int begin = bounds[c], middle = bounds[c + width], end = bounds[std::min(c + 2 * width, chunks)];
+                std::inplace_merge(keyed.begin() + begin, keyed.begin() + middle, keyed.begin() + end);
+            }
+        });
+    }
+
+    codes.resize(count);
+    order.resize(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        codes[i] = keyed[i].first;
+        order[i] = keyed[i].second;
+    }
+}
+
+//Bodies in [begin, end) share the top `level` octant digits, so the next digit splits them into contiguous runs
+void BarnesHut::splitByOctant(unsigned int begin, unsigned int end, unsigned int level, unsigned int* childBegin, unsigned int* childEnd, unsigned int& childCount) const {
+    unsigned int shift = 3 * (MAX_DEPTH - 1 - level);
+    childCount = 0;
+    unsigned int i = begin;
+    while (i < end) {
+        uint64_t octant = (codes[i] >> shift) & 7;
+        unsigned int runEnd = i + 1;
+        while (runEnd < end && ((codes[runEnd] >> shift) & 7) == octant) {
+            ++runEnd;
+        }
+        childBegin[childCount] = i;
+        childEnd[childCount] = runEnd;
+        ++childCount;
+        i = runEnd;
+    }
+}
+
+void BarnesHut::buildNode(std::vector<Node>& arena, unsigned int nodeIndex, unsigned int begin, unsigned int end, unsigned int level) const {
+    Node node;
+    node.size = rootSize / (double)(1u << level);
+    node.bodyBegin = begin;
+    node.bodyEnd = end;
+    node.firstChild = 0;
+    node.childCount = 0;
+
+    if (end - begin <= leafCapacity || level == MAX_DEPTH) {
+        double m = 0.0, mx = 0.0, my = 0.0, mz = 0.0;
+        for (unsigned int i = begin; i < end; ++i) {
+            m += sortedMass[i];
+            mx += sortedMass[i] * sortedX[i];
+            my += sortedMass[i] * sortedY[i];
+            mz += sortedMass[i] * sortedZ[i];
+        }
+        node.mass = m;
+        node.comX = m > 0.0 ? mx / m : sortedX[begin];
+        node.comY = m > 0.0 ? my / m : sortedY[begin];
+        node.comZ = m > 0.0 ? mz / m : sortedZ[begin];
+        arena[nodeIndex] = node;
+        return;
+    }
+
+    unsigned int childBegin[8], childEnd[8], childCount;
+    splitByOctant(begin, end, level, childBegin, childEnd, childCount);
+    node.firstChild = arena.size();
+    node.childCount = childCount;
+    arena.resize(arena.size() + childCount);
+    //arena may reallocate while children are built, so only indices are held across the calls
+    for (unsigned int c = 0; c < childCount; ++c) {
+        buildNode(arena, node.firstChild + c, childBegin[c], childEnd[c], level + 1);
+    }
+
+    double m = 0.0, mx = 0.0, my = 0.0, mz = 0.0;
+    for (unsigned int c = 0; c < childCount; ++c) {
+        const Node& child = arena[node.firstChild + c];
+        m += child.mass;
+        mx += child.mass * child.comX;
+        my += child.mass * child.comY;
+        mz += child.mass * child.comZ;
+    }
+    node.mass = m;
+    node.comX = m > 0.0 ? mx / m : arena[node.firstChild].comX;
+    node.comY = m > 0.0 ? my / m : arena[node.firstChild].comY;
+    node.comZ = m > 0.0 ? mz / m : arena[node.firstChild].comZ;
+    arena[nodeIndex] = node;
+}
+
+void BarnesHut::build(const double* x, const double* y, const double* z, const double* mass, unsigned int count) {
+    nodes.clear();
+    if (count == 0) {
+        return;
+    }
+    sortBodies(x, y, z, count);
+
+    sortedX.resize(count);
+    sortedY.resize(count);
+    sortedZ.resize(count);
+    sortedMass.resize(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        unsigned int b = order[i];
+        sortedX[i] = x[b];
+        sortedY[i] = y[b];
+        sortedZ[i] = z[b];
+        sortedMass[i] = mass[b];
+    }
+
+    //Small trees are not worth the threads
+    nodes.resize(1);
+    if (JobSystem::getThreadCount() <= 1 || count <= leafCapacity || count < 4096) {
+        buildNode(nodes, 0, 0, count, 0);
+        return;
+    }
+
+    unsigned int childBegin[8], childEnd[8], childCount;
+    splitByOctant(0, count, 0, childBegin, childEnd, childCount);
+
+    //Each top-level subtree goes into its own arena (local index 0 is the subtree root)
+    subtreeArenas.resize(childCount);
+    JobSystem::parallelFor(childCount, 1, [this, &childBegin, &childEnd](unsigned int first, unsigned int last) {
+        for (unsigned int c = first; c < last; ++c) {
+            std::vector<Node>& arena = subtreeArenas[c];
+            arena.clear();
+            arena.resize(1);
+            buildNode(arena, 0, childBegin[c], childEnd[c], 1);
+        }
+    });
+
+    //Splice: subtree roots sit together after the global root, the rest of each arena is appended
+    Node root;
+    root.size = rootSize;
+    root.bodyBegin = 0;
+    root.bodyEnd = count;
+    root.firstChild = 1;
+    root.childCount = childCount;
+    nodes.resize(1 + childCount);
+    double m = 0.0, mx = 0.0, my = 0.0, mz = 0.0;
+    for (unsigned int c = 0; c < childCount; ++c) {
+        const std::vector<Node>& arena = subtreeArenas[c];
+        //Local index j >= 1 ends up at base + j - 1
+        unsigned int base = nodes.size();
+        for (unsigned int j = 0; j < arena.size(); ++j) {
+            Node node = arena[j];
+            if (node.childCount > 0) {
+                node.firstChild = base + node.firstChild - 1;
+            }
+            if (j == 0) {
+                nodes[1 + c] = node;
+            }
+            else {
+                nodes.push_back(node);
+            }
+        }
+        const Node& child = nodes[1 + c];
+        m += child.mass;
+        mx += child.mass * child.comX;
+        my += child.mass * child.comY;
+        mz += child.mass * child.comZ;
+    }
+    root.mass = m;
+    root.comX = m > 0.0 ? mx / m : nodes[1].comX;
+    root.comY = m > 0.0 ? my / m : nodes[1].comY;
+    root.comZ = m > 0.0 ? mz / m : nodes[1].comZ;
+    nodes[0] = root;
+}
+
+//Walks the tree for sorted bodies [begin, end); neighbours in Morton order visit nearly the same nodes
+void BarnesHut::accelerationRange(unsigned int begin, unsigned int end, double* ax, double* ay, double* az, double G, double softening) const {
+    double eps2 = softening * softening;
+    double theta2 = theta * theta;
+    //Deepest path holds at most 7 pending siblings per level
+    unsigned int stack[8 * (MAX_DEPTH + 2)];
+
+    for (unsigned int i = begin; i < end; ++i) {
+        double xi = sortedX[i], yi = sortedY[i], zi = sortedZ[i];
+        double sumX = 0.0, sumY = 0.0, sumZ = 0.0;
+        unsigned int top = 0;
+        stack[top++] = 0;
+
+        while (top > 0) {
+            const Node& node = nodes[stack[--top]];
+            double dx = node.comX - xi;
+            double dy = node.comY - yi;
+            double dz = node.comZ - zi;
+            double dist2 = dx * dx + dy * dy + dz * dz;
+
+            if (node.childCount == 0) {
+                //Leaf: sum its bodies exactly (a body's pull on itself is zero thanks to softening)
+                for (unsigned int j = node.bodyBegin; j < node.bodyEnd; ++j) {
+                    double bx = sortedX[j] - xi;
+                    double by = sortedY[j] - yi;
+                    double bz = sortedZ[j] - zi;
+                    double invDist = 1.0 / std::sqrt(bx * bx + by * by + bz * bz + eps2);
+                    double strength = sortedMass[j] * invDist * invDist * invDist;
+                    sumX += bx * strength;
+                    sumY += by * strength;
+                    sumZ += bz * strength;
+                }
+            }
+            else if (node.size * node.size < theta2 * dist2) {
+                //Far enough away to treat the whole cell as one mass
+                double invDist = 1.0 / std::sqrt(dist2 + eps2);
+                double strength = node.mass * invDist * invDist * invDist;
+                sumX += dx * strength;
+                sumY += dy * strength;
+                sumZ += dz * strength;
+            }
+            else {
+                for (unsigned int c = 0; c < node.childCount; ++c) {
+                    stack[top++] = node.firstChild + c;
+                }
+            }
+        }
+
+        unsigned int b = order[i];
+        ax[b] = G * sumX;
+        ay[b] = G * sumY;
+        az[b] = G * sumZ;
+    }
+}
+
+void BarnesHut::computeAccelerations(double* ax, double* ay, double* az, double G, double softening) const {
+    unsigned int count = order.size();
+    if (nodes.empty()) {
+        return;
+    }
+    //Small chunks so idle workers can steal from dense regions of the Morton order
+    JobSystem::parallelFor(count, 1024, [=](unsigned int begin, unsigned int end) {
+        accelerationRange(begin, end, ax, ay, az, G, softening);
+    });
+}
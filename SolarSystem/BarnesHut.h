@@ -0,0 +1,55 @@
+#ifndef BARNESHUT_H
+#define BARNESHUT_H
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+//O(N log N) gravity using a Barnes-Hut octree, rebuilt from scratch every step.
+//
+//Bodies are sorted along a Morton (Z-order) curve first, so every octree cell is a
+//contiguous range of the sorted arrays. Nodes live in one arena vector that is cleared,
+//not freed, between builds, and a node's children are stored next to each other.
+//The eight top-level subtrees are built as separate jobs and then spliced into the arena.
+class BarnesHut {
+private:
+	struct Node {
+		double comX, comY, comZ, mass;
+		//Edge length of the cell
+		double size;
+		//Children are arena[firstChild .. firstChild + childCount); leaves have childCount 0
+		unsigned int firstChild, childCount;
+		//Range of the sorted body arrays inside this cell
+		unsigned int bodyBegin, bodyEnd;
+	};
+	std::vector<Node> nodes;
+	std::vector<std::vector<Node>> subtreeArenas;
+	//Bodies in Morton order, copied so leaf sums read contiguous memory
+	std::vector<uint64_t> codes;
+	std::vector<unsigned int> order;
+	//Sort scratch: (Morton code, body) pairs, kept between builds like the arenas
+	std::vector<std::pair<uint64_t, unsigned int>> keyed;
+	std::vector<double> sortedX, sortedY, sortedZ, sortedMass;
+	double theta;
+	unsigned int leafCapacity;
+	double rootSize;
+
+	void sortBodies(const double* x, const double* y, const double* z, unsigned int count);
+	void buildNode(std::vector<Node>& arena, unsigned int nodeIndex, unsigned int begin, unsigned int end, unsigned int level) const;
+	void splitByOctant(unsigned int begin, unsigned int end, unsigned int level, unsigned int* childBegin, unsigned int* childEnd, unsigned int& childCount) const;
+	void accelerationRange(unsigned int begin, unsigned int end, double* ax, double* ay, double* az, double G, double softening) const;
+public:
+	//Morton codes use 21 bits per axis, so the tree is never deeper than this
+	static const unsigned int MAX_DEPTH = 21;
+	//theta is the opening angle: a cell is used as a single mass when size / distance < theta.
+	//0 gives the exact direct sum; 0.5 is the usual speed/accuracy balance.
+	BarnesHut(double theta = 0.5, unsigned int leafCapacity = 8);
+	void setTheta(double theta) { this->theta = theta; }
+	double getTheta() const { return theta; }
+	void build(const double* x, const double* y, const double* z, const double* mass, unsigned int count);
+	//Uses the most recent build. Results are written in the caller's original body order.
+	void computeAccelerations(double* ax, double* ay, double* az, double G, double softening) const;
+	unsigned int getNodeCount() const { return nodes.size(); }
+};
+
+#endif
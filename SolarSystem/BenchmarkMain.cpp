@@ -0,0 +1,365 @@
+//Entry point for the benchmark suite: synthetic scenes of increasing size, timed headless with no GPU.
+//Built from the same GL-free sources as the headless simulator, e.g. on Linux:
+//  g++ -O2 -std=c++17 -pthread BenchmarkMain.cpp Simulation.cpp BodyStore.cpp OrbitKernel.cpp GravitySystem.cpp BarnesHut.cpp Catalog.cpp MappedFile.cpp JobSystem.cpp
+//      Culler.cpp LodSelector.cpp MeshBuilder.cpp Profiler.cpp CollisionDetector.cpp -o solarsystem-bench
+//
+//Usage: solarsystem-bench [--sizes 10,10000,1000000,10000000] [--repeat N] [--frames N] [--threads N]
+//                         [--scratch DIR] [--out FILE] [--baseline FILE] [--tolerance FRACTION]
+//
+//Every scene is the built-in solar system plus a seeded asteroid belt up to the requested body count,
+//so runs are reproducible. Each benchmark (the scene build included) is repeated and its median and fastest time reported.
+//Results are written as JSON, one result per line; given a baseline from an earlier run, any
+//benchmark whose median got slower by more than the tolerance is reported and the exit code is 2.
+//A baseline measured with a different thread count or kernel is refused.
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <memory>
+
+#include "Simulation.h"
+#include "OrbitKernel.h"
+#include "Catalog.h"
+#include "JobSystem.h"
+#include "Culler.h"
+#include "LodSelector.h"
+#include "MeshBuilder.h"
+
+struct Result {
+    std::string benchmark;
+    //Bodies in the scene, or divisions for the mesh benchmarks
+    unsigned long long size;
+    double medianMs;
+    double minMs;
+    //Items per second at the median time
+    double rate;
+    std::string unit;
+};
+
+static void printUsage() {
+    std::cout << "Usage: solarsystem-bench [--sizes 10,10000,1000000,10000000] [--repeat N] [--frames N] [--threads N]\n"
+              << "                         [--scratch DIR] [--out FILE] [--baseline FILE] [--tolerance FRACTION]" << std::endl;
+}
+
+//Runs body `repeat` times and returns the per-run times in milliseconds, sorted.
+//setup, if given, runs untimed before each run
+static std::vector<double> timeRuns(unsigned int repeat, const std::function<void()>& body, const std::function<void()>& setup = nullptr) {
+    std::vector<double> times;
+    for (unsigned int run = 0; run < repeat; ++run) {
+        if (setup) {
+            setup();
+        }
+        auto start = std::chrono::steady_clock::now();
+        body();
+        times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(times.begin(), times.end());
+    return times;
+}
+
+static Result makeResult(const std::string& benchmark, unsigned long long size, const std::vector<double>& times, double items, const std::string& unit) {
+    Result result;
+    result.benchmark = benchmark;
+    result.size = size;
+    result.medianMs = times[times.size() / 2];
+    result.minMs = times.front();
+    result.rate = result.medianMs > 0.0 ? items / (result.medianMs / 1000.0) : 0.0;
+    result.unit = unit;
+    std::printf("%-18s %10llu  median %10.3fms  min %10.3fms  %12.4g %s\n", benchmark.c_str(), size, result.medianMs, result.minMs, result.rate, unit.c_str());
+    return result;
+}
+
+static void buildScene(Simulation& simulation, unsigned long long bodies) {
+    simulation.loadSolarSystem();
+    if (bodies > simulation.size()) {
+        simulation.addAsteroidBelt(0, (unsigned int)(bodies - simulation.size()), 190.0f, 340.0f, 1);
+    }
+}
+
+//Column-major perspective(fovY, aspect, near, far) * lookAt(eye, origin, +y), as glm would build it,
+//written out here so the benchmark does not need glm
+static void makeViewProjection(float* out, float fovY, float aspect, float nearPlane, float farPlane, Vector3 eye) {
+    float f = 1.0f / std::tan(fovY / 2.0f);
+    float projection[16] = { f / aspect, 0, 0, 0,  0, f, 0, 0,  0, 0, (farPlane + nearPlane) / (nearPlane - farPlane), -1,  0, 0, 2.0f * farPlane * nearPlane / (nearPlane - farPlane), 0 };
+
+    Vector3 forward = { -eye.x, -eye.y, -eye.z };
+    float length = std::sqrt(forward.x * forward.x + forward.y * forward.y + forward.z * forward.z);
+    forward = { forward.x / length, forward.y / length, forward.z / length };
+    //side = forward x up, up = (0, 1, 0)
+    Vector3 side = { -forward.z, 0.0f, forward.x };
+    length = std::sqrt(side.x * side.x + side.z * side.z);
+    side = { side.x / length, 0.0f, side.z / length };
+    Vector3 up = { side.y * forward.z - side.z * forward.y, side.z * forward.x - side.x * forward.z, side.x * forward.y - side.y * forward.x };
+    float view[16] = { side.x, up.x, -forward.x, 0,  side.y, up.y, -forward.y, 0,  side.z, up.z, -forward.z, 0,
+        -(side.x * eye.x + side.y * eye.y + side.z * eye.z), -(up.x * eye.x + up.y * eye.y + up.z * eye.z), forward.x * eye.x + forward.y * eye.y + forward.z * eye.z, 1 };
+
+    for (unsigned int column = 0; column < 4; ++column) {
+        for (unsigned int row = 0; row < 4; ++row) {
+            float sum = 0.0f;
+            for (unsigned int k = 0; k < 4; ++k) {
+                sum += projection[k * 4 + row] * view[column * 4 + k];
+            }
+            out[column * 4 + row] = sum;
+        }
+    }
+}
+
+static void runSceneBenchmarks(unsigned long long bodies, unsigned int repeat, unsigned int frames, const std::string& scratch, std::vector<Result>& results) {
+    //Scene build: the same path addAsteroidBelt takes when the app stress-tests. Each run builds into
+    //a fresh Simulation (made, and the last one freed, outside the timing); the last one is used below
+    std::unique_ptr<Simulation> built;
+    std::vector<double> times = timeRuns(repeat, [&]() { buildScene(*built, bodies); }, [&]() {
+        built.reset();
+        built.reset(new Simulation());
+    });
+    Simulation& simulation = *built;
+    results.push_back(makeResult("scene_build", bodies, times, (double)bodies, "bodies/s"));
+
+    //Scene load: a binary catalog of the same scene, memory mapped and bulk appended
+    std::string catalogPath = scratch + "/solarsystem-bench-" + std::to_string(bodies) + ".ssc";
+    if (Catalog::saveBinary(simulation, catalogPath)) {
+        times = timeRuns(repeat, [&]() {
+            Simulation loaded;
+            Catalog::load(loaded, catalogPath);
+        });
+        results.push_back(makeResult("scene_load", bodies, times, (double)bodies, "bodies/s"));
+        std::remove(catalogPath.c_str());
+    }
+
+    //Propagation: every body evaluated at a new absolute time, once per frame
+    double time = 0.0;
+    times = timeRuns(repeat, [&]() {
+        for (unsigned int frame = 0; frame < frames; ++frame) {
+            time += 1.0 / 60.0;
+            simulation.seek(time);
+        }
+    });
+    results.push_back(makeResult("propagate", bodies, times, (double)bodies * frames, "bodies/s"));
+
+    //The one-body-at-a-time double precision path, as the original per-satellite update did it
+    BodyStore& store = simulation.getBodies();
+    times = timeRuns(repeat, [&]() {
+        for (unsigned int id = 0; id < bodies; ++id) {
+            store.updateOrbit(id);
+        }
+    });
+    results.push_back(makeResult("propagate_scalar", bodies, times, (double)bodies, "bodies/s"));
+
+    //Render prep: what the window does on the CPU each frame before any GL call
+    Culler culler;
+    culler.setPixelThreshold(1.0f);
+    LodSelector lod;
+    float viewProjection[16];
+    const float fovY = 0.7853982f, viewportHeight = 800.0f;
+    makeViewProjection(viewProjection, fovY, 1.5f, 0.1f, 100000.0f, Vector3{ 0.0f, 400.0f, 900.0f });
+    culler.setCamera(viewProjection, 1.0f / std::tan(fovY / 2.0f), viewportHeight);
+    std::vector<unsigned int> visible, points;
+    simulation.setInterpolation(true);
+
+    times = timeRuns(repeat, [&]() {
+        for (unsigned int frame = 0; frame < frames; ++frame) {
+            simulation.advance(1.0f / 60.0f);
+            simulation.publish();
+            simulation.swapPublished();
+        }
+    });
+    results.push_back(makeResult("step_and_publish", bodies, times, (double)frames, "frames/s"));
+
+    //The same frames with every step screened for close approaches
+    simulation.getCollisions().setApproachDistance(1.0f);
+    simulation.setCollisionDetection(true);
+    std::vector<CollisionEvent> events;
+    times = timeRuns(repeat, [&]() {
+        for (unsigned int frame = 0; frame < frames; ++frame) {
+            simulation.advance(1.0f / 60.0f);
+            simulation.publish();
+            simulation.swapPublished();
+            events.clear();
+            simulation.takeCollisionEvents(events);
+        }
+    });
+    simulation.setCollisionDetection(false);
+    results.push_back(makeResult("step_with_collisions", bodies, times, (double)frames, "frames/s"));
+
+    const std::vector<Vector3>& positions = simulation.getPublished();
+    times = timeRuns(repeat, [&]() {
+        for (unsigned int frame = 0; frame < frames; ++frame) {
+            culler.cull(positions.data(), simulation.getRadii().data(), positions.size(), visible, points);
+        }
+    });
+    results.push_back(makeResult("cull", bodies, times, (double)bodies * frames, "bodies/s"));
+
+    times = timeRuns(repeat, [&]() {
+        for (unsigned int frame = 0; frame < frames; ++frame) {
+            lod.select(positions.data(), simulation.getRadii().data(), visible, culler, positions.size());
+        }
+    });
+    results.push_back(makeResult("lod_select", bodies, times, (double)visible.size() * frames, "bodies/s"));
+    std::printf("%-18s %10llu  %u meshes, %u points\n", "  (culled view)", bodies, (unsigned int)visible.size(), (unsigned int)points.size());
+}
+
+static void runMeshBenchmarks(unsigned int repeat, std::vector<Result>& results) {
+    //The level-of-detail chain plus two finer tessellations (the finest needs 32-bit indices)
+    LodSelector lod;
+    std::vector<unsigned int> divisions;
+    for (unsigned int level = 0; level < lod.getLevelCount(); ++level) {
+        divisions.push_back(lod.getDivisions(level));
+    }
+    divisions.push_back(128);
+    divisions.push_back(320);
+    for (unsigned int division : divisions) {
+        unsigned int vertices = 0;
+        std::vector<double> times = timeRuns(repeat, [&]() {
+            vertices = MeshBuilder::buildSphere(division, division).vertexCount;
+        });
+        results.push_back(makeResult("mesh_build", division, times, (double)vertices, "vertices/s"));
+    }
+}
+
+static bool writeResults(const std::string& path, const std::vector<Result>& results) {
+    std::ofstream file(path);
+    if (!file) {
+        std::cout << "Failed to write results " << path << std::endl;
+        return false;
+    }
+    file << "{\"suite\":\"solarsystem-bench\",\"threads\":" << JobSystem::getThreadCount()
+         << ",\"kernel\":\"" << OrbitKernel::getKernelName() << "\",\"results\":[\n";
+    char line[256];
+    for (unsigned int i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        std::snprintf(line, sizeof(line), "{\"benchmark\":\"%s\",\"size\":%llu,\"median_ms\":%.6f,\"min_ms\":%.6f,\"rate\":%.6g,\"unit\":\"%s\"}%s\n",
+                      result.benchmark.c_str(), result.size, result.medianMs, result.minMs, result.rate, result.unit.c_str(), i + 1 < results.size() ? "," : "");
+        file << line;
+    }
+    file << "]}\n";
+    std::cout << "Wrote " << results.size() << " results to " << path << std::endl;
+    return (bool)file;
+}
+
+//Reads results written by writeResults (one per line), and the thread count and kernel they were
+//measured with; anything else in the file is ignored
+static std::vector<Result> readResults(const std::string& path, unsigned int& threads, std::string& kernel) {
+    std::vector<Result> results;
+    threads = 0;
+    kernel.clear();
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        char name[64];
+        Result result;
+        if (std::sscanf(line.c_str(), "{\"benchmark\":\"%63[^\"]\",\"size\":%llu,\"median_ms\":%lf,\"min_ms\":%lf", name, &result.size, &result.medianMs, &result.minMs) == 4) {
+            result.benchmark = name;
+            results.push_back(result);
+        }
+        else if (std::sscanf(line.c_str(), "{\"suite\":\"solarsystem-bench\",\"threads\":%u,\"kernel\":\"%63[^\"]\"", &threads, name) == 2) {
+            kernel = name;
+        }
+    }
+    return results;
+}
+
+//Differences smaller than this are timer noise on the tiny scenes, whatever the percentage
+static const double NOISE_FLOOR_MS = 0.05;
+
+//Returns the number of benchmarks whose median is more than `tolerance` slower than in the baseline
+static unsigned int compareResults(const std::vector<Result>& baseline, const std::vector<Result>& results, double tolerance) {
+    unsigned int regressions = 0;
+    for (const Result& result : results) {
+        for (const Result& old : baseline) {
+            if (old.benchmark != result.benchmark || old.size != result.size) {
+                continue;
+            }
+            double change = old.medianMs > 0.0 ? result.medianMs / old.medianMs - 1.0 : 0.0;
+            if (change > tolerance && result.medianMs - old.medianMs > NOISE_FLOOR_MS) {
+                std::printf("REGRESSION %-18s %10llu  %.3fms -> %.3fms (%+.1f%%)\n", result.benchmark.c_str(), result.size, old.medianMs, result.medianMs, change * 100.0);
+                ++regressions;
+            }
+        }
+    }
+    std::cout << regressions << " regression(s) against " << baseline.size() << " baseline results" << std::endl;
+    return regressions;
+}
+
+int main(int argc, char** argv) {
+    std::vector<unsigned long long> sizes = { 10, 10000, 1000000, 10000000 };
+    unsigned int repeat = 5;
+    unsigned int frames = 10;
+    unsigned int threads = 0;
+    double tolerance = 0.10;
+    std::string scratch = ".", outPath = "bench_results.json", baselinePath;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--sizes" && hasValue) {
+            sizes.clear();
+            std::string list = argv[++i];
+            for (std::size_t start = 0; start < list.size();) {
+                std::size_t comma = list.find(',', start);
+                sizes.push_back(std::strtoull(list.substr(start, comma - start).c_str(), nullptr, 10));
+                start = comma == std::string::npos ? list.size() : comma + 1;
+            }
+        }
+        else if (arg == "--repeat" && hasValue) {
+            repeat = std::max(1u, (unsigned int)std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--frames" && hasValue) {
+            frames = std::max(1u, (unsigned int)std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--threads" && hasValue) {
+            threads = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--scratch" && hasValue) {
+            scratch = argv[++i];
+        }
+        else if (arg == "--out" && hasValue) {
+            outPath = argv[++i];
+        }
+        else if (arg == "--baseline" && hasValue) {
+            baselinePath = argv[++i];
+        }
+        else if (arg == "--tolerance" && hasValue) {
+            tolerance = std::atof(argv[++i]);
+        }
+        else {
+            printUsage();
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    JobSystem::start(threads);
+    std::cout << "Job system: " << JobSystem::getThreadCount() << " threads, Kepler kernel: " << OrbitKernel::getKernelName() << std::endl;
+
+    std::vector<Result> results;
+    runMeshBenchmarks(repeat, results);
+    for (unsigned long long bodies : sizes) {
+        runSceneBenchmarks(bodies, repeat, frames, scratch, results);
+    }
+    if (!writeResults(outPath, results)) {
+        return 1;
+    }
+
+    if (!baselinePath.empty()) {
+        unsigned int baselineThreads;
+        std::string baselineKernel;
+        std::vector<Result> baseline = readResults(baselinePath, baselineThreads, baselineKernel);
+        if (baseline.empty()) {
+            std::cout << "No results in baseline " << baselinePath << std::endl;
+            return 1;
+        }
+        //Times from a different thread count or Kepler kernel are not comparable
+        if (baselineThreads != JobSystem::getThreadCount() || baselineKernel != OrbitKernel::getKernelName()) {
+            std::cout << "Baseline " << baselinePath << " was measured with " << baselineThreads << " threads and the " << baselineKernel
+                      << " kernel, this run with " << JobSystem::getThreadCount() << " threads and the " << OrbitKernel::getKernelName() << " kernel; not comparing" << std::endl;
+            return 1;
+        }
+        return compareResults(baseline, results, tolerance) > 0 ? 2 : 0;
+    }
+    return 0;
+}
@@ -0,0 +1,373 @@
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+#include "BodyStore.h"
+#include "OrbitKernel.h"
+#include "JobSystem.h"
+
+static const double TWO_PI = 6.28318530717958647692;
+
+//Mean anomaly reduced to [-pi, pi]; done in double so a large time loses nothing before the wrap
+static double wrapAngle(double a) {
+	return a - TWO_PI * std::nearbyint(a / TWO_PI);
+}
+
+//Newton run until it stops moving, for the reference path and velocities
+static double solveKeplerExact(double meanAnomaly, double e) {
+	double eccentricAnomaly = e < 0.8 ? meanAnomaly : meanAnomaly + std::copysign(0.85 * e, std::sin(meanAnomaly));
+	for (unsigned int k = 0; k < 50; ++k) {
+		double step = (eccentricAnomaly - e * std::sin(eccentricAnomaly) - meanAnomaly) / (1.0 - e * std::cos(eccentricAnomaly));
+		eccentricAnomaly -= step;
+		if (std::fabs(step) < 1e-15) {
+			break;
+		}
+	}
+	return eccentricAnomaly;
+}
+
+template<typename T>
+static void permute(std::vector<T>& values, const std::vector<unsigned int>& from) {
+	std::vector<T> moved(from.size());
+	for (unsigned int i = 0; i < from.size(); ++i) {
+		moved[i] = values[from[i]];
+	}
+	values.swap(moved);
+}
+
+BodyStore::BodyStore() {
+	levelsDirty = false;
+	time = 0.0;
+	levelStart.push_back(0);
+}
+
+unsigned int BodyStore::addBody(int parentId, float radius, float speed, float startAngle, OrbitShape shape) {
+	int noParent = -1;
+	unsigned int id = appendBodies(1, &noParent, &radius, &speed, &startAngle, &shape);
+	//appendBodies takes relative parents, this one is absolute
+	parentBody[id] = parentId;
+	return id;
+}
+
+unsigned int BodyStore::appendBodies(unsigned int count, const int* parents, const float* radii, const float* speeds, const float* startAngles, const OrbitShape* newShapes) {
+	unsigned int first = parentBody.size();
+	unsigned int total = first + count;
+	//This is in radians per second
+	angularSpeed.insert(angularSpeed.end(), speeds, speeds + count);
+	orbitRadius.insert(orbitRadius.end(), radii, radii + count);
+	angle.insert(angle.end(), startAngles, startAngles + count);
+	epochAnomaly.resize(total);
+	for (unsigned int i = first; i < total; ++i) {
+		//Start angles are given for now, the elements hold the anomaly at time 0
+		epochAnomaly[i] = (float)wrapAngle(startAngles[i - first] - (double)speeds[i - first] * time);
+	}
+	eccentricity.resize(total);
+	semiMinor.resize(total);
+	axisPX.resize(total);
+	axisPY.resize(total);
+	axisPZ.resize(total);
+	axisQX.resize(total);
+	axisQY.resize(total);
+	axisQZ.resize(total);
+	parent.resize(total, -1);
+	posX.resize(total, 0.0f);
+	posY.resize(total, 0.0f);
+	posZ.resize(total, 0.0f);
+
+	parentBody.insert(parentBody.end(), parents, parents + count);
+	if (first > 0) {
+		for (unsigned int id = first; id < total; ++id) {
+			if (parentBody[id] >= 0) {
+				parentBody[id] += first;
+			}
+		}
+	}
+	shapes.resize(total, OrbitShape());
+	slotOfBody.resize(total);
+	bodyOfSlot.resize(total);
+	for (unsigned int id = first; id < total; ++id) {
+		slotOfBody[id] = id;
+		bodyOfSlot[id] = id;
+	}
+	if (newShapes != nullptr) {
+		for (unsigned int id = first; id < total; ++id) {
+			setShape(id, newShapes[id - first]);
+		}
+	}
+	else {
+		//Circles in the xz plane, without the trigonometry
+		for (unsigned int i = first; i < total; ++i) {
+			semiMinor[i] = orbitRadius[i];
+			axisPX[i] = 1.0f;
+			axisQZ[i] = 1.0f;
+		}
+	}
+	levelsDirty = true;
+	return first;
+}
+
+void BodyStore::setParent(unsigned int id, int parentId) {
+	parentBody[id] = parentId;
+	levelsDirty = true;
+}
+
+void BodyStore::setShape(unsigned int id, OrbitShape shape) {
+	shape.eccentricity = std::min(std::max(shape.eccentricity, 0.0f), OrbitKernel::MAX_ECCENTRICITY);
+	shapes[id] = shape;
+	setSlotShape(slotOfBody[id], shape);
+}
+
+void BodyStore::setSlotShape(unsigned int slot, OrbitShape shape) {
+	double e = shape.eccentricity;
+	eccentricity[slot] = shape.eccentricity;
+	semiMinor[slot] = (float)(orbitRadius[slot] * std::sqrt(1.0 - e * e));
+
+	//Standard perifocal-to-reference rotation, with the reference normal along +y
+	//(the textbook x, y, z become the scene's x, z, y)
+	double cosNode = std::cos(shape.ascendingNode), sinNode = std::sin(shape.ascendingNode);
+	double cosPeri = std::cos(shape.argumentOfPeriapsis), sinPeri = std::sin(shape.argumentOfPeriapsis);
+	double cosInc = std::cos(shape.inclination), sinInc = std::sin(shape.inclination);
+	axisPX[slot] = (float)(cosPeri * cosNode - sinPeri * sinNode * cosInc);
+	axisPZ[slot] = (float)(cosPeri * sinNode + sinPeri * cosNode * cosInc);
+	axisPY[slot] = (float)(sinPeri * sinInc);
+	axisQX[slot] = (float)(-sinPeri * cosNode - cosPeri * sinNode * cosInc);
+	axisQZ[slot] = (float)(-sinPeri * sinNode + cosPeri * cosNode * cosInc);
+	axisQY[slot] = (float)(cosPeri * sinInc);
+}
+
+void BodyStore::reserve(unsigned int count) {
+	epochAnomaly.reserve(count);
+	angularSpeed.reserve(count);
+	orbitRadius.reserve(count);
+	eccentricity.reserve(count);
+	semiMinor.reserve(count);
+	axisPX.reserve(count);
+	axisPY.reserve(count);
+	axisPZ.reserve(count);
+	axisQX.reserve(count);
+	axisQY.reserve(count);
+	axisQZ.reserve(count);
+	angle.reserve(count);
+	parent.reserve(count);
+	posX.reserve(count);
+	posY.reserve(count);
+	posZ.reserve(count);
+	parentBody.reserve(count);
+	shapes.reserve(count);
+	slotOfBody.reserve(count);
+	bodyOfSlot.reserve(count);
+}
+
+//Breadth-first walk from the roots: gives each level contiguously, and within a level
+//keeps siblings next to each other so they all read the same parent position.
+void BodyStore::buildLevels() {
+	unsigned int count = size();
+
+	for (unsigned int id = 0; id < count; ++id) {
+		if (parentBody[id] >= (int)count || parentBody[id] == (int)id) {
+			std::cout << "Body " << id << " has an invalid parent " << parentBody[id] << ", orbiting the origin instead" << std::endl;
+			parentBody[id] = -1;
+		}
+	}
+	//A body on a parent cycle would never be reached from a root. Each walk follows parents until it
+	//meets a root, a body an earlier walk settled, or a body of its own, which closes a new cycle and
+	//is detached; so every cycle is broken in one pass
+	std::vector<unsigned int> walk(count, 0);
+	for (unsigned int id = 0; id < count; ++id) {
+		int body = id;
+		while (body >= 0 && walk[body] == 0) {
+			walk[body] = id + 1;
+			body = parentBody[body];
+		}
+		if (body >= 0 && walk[body] == id + 1) {
+			std::cout << "Body " << body << " is part of a parent cycle, orbiting the origin instead" << std::endl;
+			parentBody[body] = -1;
+		}
+	}
+
+	//Children of each body as a flattened (counting sort) list, ids in ascending order
+	std::vector<unsigned int> childStart(count + 1, 0);
+	for (unsigned int id = 0; id < count; ++id) {
+		if (parentBody[id] >= 0) {
+			++childStart[parentBody[id] + 1];
+		}
+	}
+	for (unsigned int id = 0; id < count; ++id) {
+		childStart[id + 1] += childStart[id];
+	}
+	std::vector<unsigned int> children(childStart[count]);
+	std::vector<unsigned int> fill(childStart.begin(), childStart.end() - 1);
+	for (unsigned int id = 0; id < count; ++id) {
+		if (parentBody[id] >= 0) {
+			children[fill[parentBody[id]]++] = id;
+		}
+	}
+
+	std::vector<unsigned int> order;
+	order.reserve(count);
+	levelStart.clear();
+	levelStart.push_back(0);
+	for (unsigned int id = 0; id < count; ++id) {
+		if (parentBody[id] < 0) {
+			order.push_back(id);
+		}
+	}
+	unsigned int levelBegin = 0;
+	while (levelBegin < order.size()) {
+		unsigned int levelEnd = order.size();
+		levelStart.push_back(levelEnd);
+		for (unsigned int i = levelBegin; i < levelEnd; ++i) {
+			unsigned int id = order[i];
+			for (unsigned int c = childStart[id]; c < childStart[id + 1]; ++c) {
+				order.push_back(children[c]);
+			}
+		}
+		levelBegin = levelEnd;
+	}
+
+	//Move every per-slot array into the new order
+	std::vector<unsigned int> from(count);
+	for (unsigned int slot = 0; slot < count; ++slot) {
+		from[slot] = slotOfBody[order[slot]];
+	}
+	permute(epochAnomaly, from);
+	permute(angularSpeed, from);
+	permute(orbitRadius, from);
+	permute(eccentricity, from);
+	permute(semiMinor, from);
+	permute(axisPX, from);
+	permute(axisPY, from);
+	permute(axisPZ, from);
+	permute(axisQX, from);
+	permute(axisQY, from);
+	permute(axisQZ, from);
+	permute(angle, from);
+	permute(posX, from);
+	permute(posY, from);
+	permute(posZ, from);
+
+	for (unsigned int slot = 0; slot < count; ++slot) {
+		bodyOfSlot[slot] = order[slot];
+		slotOfBody[order[slot]] = slot;
+	}
+	for (unsigned int slot = 0; slot < count; ++slot) {
+		int p = parentBody[bodyOfSlot[slot]];
+		parent[slot] = p < 0 ? -1 : (int)slotOfBody[p];
+	}
+
+	levelsDirty = false;
+}
+
+unsigned int BodyStore::getLevelCount() {
+	if (levelsDirty) {
+		buildLevels();
+	}
+	return levelStart.size() - 1;
+}
+
+void BodyStore::evaluateSlot(unsigned int i) {
+	double m = wrapAngle(epochAnomaly[i] + (double)angularSpeed[i] * time);
+	angle[i] = (float)m;
+	double e = eccentricity[i];
+	double eccentricAnomaly = solveKeplerExact(m, e);
+	double x = orbitRadius[i] * (std::cos(eccentricAnomaly) - e);
+	double y = semiMinor[i] * std::sin(eccentricAnomaly);
+
+	float centreX = 0.0f, centreY = 0.0f, centreZ = 0.0f;
+	if (parent[i] >= 0) {
+		centreX = posX[parent[i]];
+		centreY = posY[parent[i]];
+		centreZ = posZ[parent[i]];
+	}
+	posX[i] = (float)(centreX + x * axisPX[i] + y * axisQX[i]);
+	posY[i] = (float)(centreY + x * axisPY[i] + y * axisQY[i]);
+	posZ[i] = (float)(centreZ + x * axisPZ[i] + y * axisQZ[i]);
+}
+
+void BodyStore::updateOrbit(unsigned int id) {
+	if (levelsDirty) {
+		buildLevels();
+	}
+	evaluateSlot(slotOfBody[id]);
+}
+
+void BodyStore::evaluateRange(unsigned int begin, unsigned int end, bool rootLevel) {
+	for (unsigned int i = begin; i < end; ++i) {
+		angle[i] = (float)wrapAngle(epochAnomaly[i] + (double)angularSpeed[i] * time);
+	}
+	//Vectorised pass: position in each orbit's own plane, written to posX/posZ for now
+	OrbitKernel::solveKepler(angle.data() + begin, eccentricity.data() + begin, orbitRadius.data() + begin, semiMinor.data() + begin,
+		posX.data() + begin, posZ.data() + begin, end - begin);
+
+	//Into the scene: rotate by the orbit's orientation, then move to the orbit centre.
+	//Every parent is in an earlier level, so it is already final
+	for (unsigned int i = begin; i < end; ++i) {
+		float x = posX[i], y = posZ[i];
+		float centreX = 0.0f, centreY = 0.0f, centreZ = 0.0f;
+		if (!rootLevel) {
+			int p = parent[i];
+			centreX = posX[p];
+			centreY = posY[p];
+			centreZ = posZ[p];
+		}
+		posX[i] = centreX + x * axisPX[i] + y * axisQX[i];
+		posY[i] = centreY + x * axisPY[i] + y * axisQY[i];
+		posZ[i] = centreZ + x * axisPZ[i] + y * axisQZ[i];
+	}
+}
+
+//Bodies within a level are independent, so a level is split into chunks across the job system
+void BodyStore::evaluateLevel(unsigned int level) {
+	unsigned int begin = levelStart[level];
+	unsigned int end = levelStart[level + 1];
+	JobSystem::parallelFor(end - begin, UPDATE_CHUNK, [this, begin, level](unsigned int first, unsigned int last) {
+		evaluateRange(begin + first, begin + last, level == 0);
+	});
+}
+
+void BodyStore::setTime(double newTime) {
+	time = newTime;
+	unsigned int levels = getLevelCount();
+	for (unsigned int level = 0; level < levels; ++level) {
+		evaluateLevel(level);
+	}
+}
+
+void BodyStore::updateOrbits(float deltaTime) {
+	setTime(time + deltaTime);
+}
+
+Vector3 BodyStore::getOrbitalVelocity(unsigned int id) const {
+	unsigned int s = slotOfBody[id];
+	double e = eccentricity[s];
+	double eccentricAnomaly = solveKeplerExact(angle[s], e);
+	//dE/dt from differentiating Kepler's equation
+	double rate = angularSpeed[s] / (1.0 - e * std::cos(eccentricAnomaly));
+	double vx = -orbitRadius[s] * std::sin(eccentricAnomaly) * rate;
+	double vy = semiMinor[s] * std::cos(eccentricAnomaly) * rate;
+	return { (float)(vx * axisPX[s] + vy * axisQX[s]), (float)(vx * axisPY[s] + vy * axisQY[s]), (float)(vx * axisPZ[s] + vy * axisQZ[s]) };
+}
+
+float BodyStore::checkBatchedAgainstScalar(double newTime, unsigned int& worstBody) const {
+	BodyStore batched = *this;
+	BodyStore scalar = *this;
+	batched.setTime(newTime);
+	scalar.getLevelCount();
+	scalar.time = newTime;
+	//Slot order is topological, so parents are evaluated before their children
+	for (unsigned int slot = 0; slot < scalar.size(); ++slot) {
+		scalar.evaluateSlot(slot);
+	}
+
+	float maxError = 0.0f;
+	worstBody = 0;
+	for (unsigned int i = 0; i < size(); ++i) {
+		//Relative to the orbit size so large and small orbits are judged alike
+		float scale = std::fmax(1.0f, batched.orbitRadius[i]);
+		float error = std::fmax(std::fabs(batched.posX[i] - scalar.posX[i]), std::fmax(std::fabs(batched.posY[i] - scalar.posY[i]), std::fabs(batched.posZ[i] - scalar.posZ[i]))) / scale;
+		if (error > maxError) {
+			maxError = error;
+			worstBody = batched.bodyOfSlot[i];
+		}
+	}
+	return maxError;
+}
@@ -0,0 +1,96 @@
+#ifndef BODYSTORE_H
+#define BODYSTORE_H
+
+#include <vector>
+#include "BodyTypes.h"
+
+//Orbital state for every body, stored as structure-of-arrays so the update loop
+//walks contiguous floats and never touches rendering data.
+//
+//Each orbit is a set of Keplerian elements: semi-major axis (orbitRadius), mean motion
+//(angularSpeed), mean anomaly at time 0 and an OrbitShape. Positions are evaluated in closed
+//form at an absolute time, so jumping to any time costs the same as one frame and nothing
+//accumulates error from step to step.
+//
+//Bodies form a tree through their parent (a star, planet, moon...). The arrays are kept
+//sorted by depth in that tree, so each level is one contiguous batch whose parents have
+//all been updated by the time it is reached. Bodies can therefore be added in any order.
+//
+//Callers refer to bodies by the id addBody returns; ids never change, but the slot
+//(array position) a body lives in does whenever the levels are rebuilt.
+class BodyStore {
+private:
+	//Per slot, in level order
+	std::vector<float> epochAnomaly, angularSpeed, orbitRadius;
+	std::vector<float> eccentricity, semiMinor;
+	//Unit vectors towards periapsis (P) and 90 degrees ahead of it in the orbit plane (Q)
+	std::vector<float> axisPX, axisPY, axisPZ, axisQX, axisQY, axisQZ;
+	//Mean anomaly at the current time, wrapped to [-pi, pi]
+	std::vector<float> angle;
+	//Slot of the body being orbited, or -1 for the origin
+	std::vector<int> parent;
+	std::vector<float> posX, posY, posZ;
+
+	//Per id: parent id as given to addBody/setParent, and the orbit shape
+	std::vector<int> parentBody;
+	std::vector<OrbitShape> shapes;
+	std::vector<unsigned int> slotOfBody;
+	std::vector<unsigned int> bodyOfSlot;
+	//levelStart[l] is the first slot at depth l; the last entry is size()
+	std::vector<unsigned int> levelStart;
+	bool levelsDirty;
+	double time;
+
+	void buildLevels();
+	void setSlotShape(unsigned int slot, OrbitShape shape);
+	void evaluateSlot(unsigned int slot);
+	void evaluateRange(unsigned int begin, unsigned int end, bool rootLevel);
+	void evaluateLevel(unsigned int level);
+	friend class Snapshot;
+public:
+	//Bodies per job when a level is evaluated in parallel (a multiple of the kernel's 16-body block)
+	static const unsigned int UPDATE_CHUNK = 16384;
+	BodyStore();
+	//parentId is the id of the body to orbit, or -1 for the origin. It does not have to exist yet.
+	//radius is the semi-major axis, speed the mean motion in radians per second and startAngle the
+	//mean anomaly at the store's current time. Positions are filled in by the next setTime/updateOrbits.
+	//Returns the new body's id.
+	unsigned int addBody(int parentId, float radius, float speed, float startAngle = 0.0f, OrbitShape shape = OrbitShape());
+	//Bulk version of addBody for loaders: each array holds count values and is copied in one go.
+	//Parent ids are relative to the first appended body (so -1 still means the origin).
+	//shapes may be null for circular orbits. Returns the id of the first appended body.
+	unsigned int appendBodies(unsigned int count, const int* parents, const float* radii, const float* speeds, const float* startAngles, const OrbitShape* shapes = nullptr);
+	void setParent(unsigned int id, int parentId);
+	void setShape(unsigned int id, OrbitShape shape);
+	void reserve(unsigned int count);
+	//Evaluates every orbit at an absolute time, level by level, using the SIMD OrbitKernel
+	void setTime(double newTime);
+	//setTime(getTime() + deltaTime)
+	void updateOrbits(float deltaTime);
+	//Evaluates a single body in double precision with libm and Newton run to convergence
+	//(the parent must already be up to date). This is the reference the batched path is checked against.
+	void updateOrbit(unsigned int id);
+	//Evaluates two copies of the store at newTime, batched and scalar, and returns the largest
+	//position difference relative to orbit radius and the id of the body it belongs to.
+	//Should stay within BATCHED_TOLERANCE.
+	float checkBatchedAgainstScalar(double newTime, unsigned int& worstBody) const;
+	//The polynomial sincos is good to about 1e-7; a hundred times that leaves room for the float Kepler
+	//iterations and for errors carried down from parents, and still catches a wrong lane or term
+	static constexpr float BATCHED_TOLERANCE = 1e-5f;
+
+	unsigned int size() const { return angle.size(); }
+	double getTime() const { return time; }
+	unsigned int getLevelCount();
+	//Bodies in level order: every parent comes before its children
+	unsigned int getBodyAtSlot(unsigned int slot) const { return bodyOfSlot[slot]; }
+	Vector3 getPos(unsigned int id) const { unsigned int s = slotOfBody[id]; return { posX[s], posY[s], posZ[s] }; }
+	//Velocity relative to the parent, from the derivative of the orbit at the current time
+	Vector3 getOrbitalVelocity(unsigned int id) const;
+	int getParent(unsigned int id) const { return parentBody[id]; }
+	float getAngle(unsigned int id) const { return angle[slotOfBody[id]]; }
+	float getAngularSpeed(unsigned int id) const { return angularSpeed[slotOfBody[id]]; }
+	float getOrbitRadius(unsigned int id) const { return orbitRadius[slotOfBody[id]]; }
+	OrbitShape getShape(unsigned int id) const { return shapes[id]; }
+};
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef BODYTYPES_H
+#define BODYTYPES_H
+
+//Plain data types shared by the simulation core and the renderer.
+//Kept free of any OpenGL or GLFW includes so the headless build can use them.
+
+struct Color {
+	float r, g, b;
+};
+
+struct Vector3 {
+	float x, y, z;
+};
+
+//Shape and orientation of a Keplerian orbit, angles in radians. All zero is a circle in the xz plane,
+//which is what every orbit was before eccentric ones were supported.
+//The reference plane is xz (y is up) and the node is measured from +x.
+struct OrbitShape {
+	float eccentricity;
+	float inclination;
+	float ascendingNode;
+	float argumentOfPeriapsis;
+};
+
+#endif
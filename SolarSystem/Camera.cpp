@@ -9,8 +9,9 @@
 #include "Camera.h"
 #include "Window.h"
 #include "Sphere.h"
+#include "FrameUniforms.h"
 
-#ifndef M+PI
+#ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
@@ -19,24 +20,24 @@ Camera::Camera() {
     //TODO Change this. Then have max and min values for angles
     posSphere = { 1000,M_PI / 4,M_PI / 2};
     pos = translatePos(posSphere);
+    viewProjection = glm::mat4(1.0f);
+    projectionScaleY = 1.0f;
+    aspect = (float)Window::getWindowWidth() / (float)Window::getWindowHeight();
 }
 
-void Camera::update(Sphere& sphere) {
+void Camera::update(FrameUniforms& frame) {
     glm::mat4 view = glm::lookAt(
         glm::vec3(pos.x, pos.y, pos.z),    //Camera pos
         glm::vec3(0.0f, 0.0f, 0.0f),    //Look at pos
         glm::vec3(0.0f, 1.0f, 0.0f));  //Up direction
 
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)Window::getWindowWidth() / (float)Window::getWindowHeight(), 0.1f, 5000.0f);
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 5000.0f);
 
-    unsigned int shaderProgram = sphere.getShaderProgram();
-    unsigned int viewLoc = glGetUniformLocation(shaderProgram, "view");
-    unsigned int projLoc = glGetUniformLocation(shaderProgram, "projection");
-    unsigned int viewPosLoc = glGetUniformLocation(shaderProgram, "viewPos");
+    viewProjection = projection * view;
+    projectionScaleY = projection[1][1];
 
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-    glUniform3f(viewPosLoc, pos.x, pos.y, pos.z);   // Camera/view position
+    //Only marks the block dirty if the camera actually moved
+    frame.setCamera(view, projection, glm::vec3(pos.x, pos.y, pos.z));
 }
 
 //Angles are in radians
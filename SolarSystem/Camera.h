@@ -3,8 +3,11 @@
 
 #include<GLFW/glfw3.h>
 #include <string>
+#include <glm.hpp>
 #include "Sphere.h"
 
+class FrameUniforms;
+
 struct sphereCoords {
 	//Polar angle is from North (vertical)
 	//Azimuth angle is horizontal from x axis
@@ -17,9 +20,17 @@ private:
 	sphereCoords posSphere;
 	const float speed = 0.2f;
 	const float angleSpeed = 0.002f;
+	glm::mat4 viewProjection;
+	float projectionScaleY;
+	//Width over height of whatever is being rendered to
+	float aspect;
 public:
 	Camera();
-	void update(Sphere& sphere);
+	void update(FrameUniforms& frame);
+	//From the last update, for culling
+	const glm::mat4& getViewProjection() const { return viewProjection; }
+	float getProjectionScaleY() const { return projectionScaleY; }
+	void setAspect(float ratio) { aspect = ratio; }
 	void move(std::string direction);
 	Vector3 translatePos(sphereCoords coords);
 };
@@ -0,0 +1,261 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstddef>
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+#include "Catalog.h"
+#include "MappedFile.h"
+
+static const char CATALOG_MAGIC[8] = { 'S', 'S', 'C', 'A', 'T', 'L', 'G', '\0' };
+
+bool Catalog::isBinary(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    char magic[8] = {};
+    file.read(magic, sizeof(magic));
+    return file && std::memcmp(magic, CATALOG_MAGIC, sizeof(magic)) == 0;
+}
+
+bool Catalog::load(Simulation& simulation, const std::string& path) {
+    return isBinary(path) ? loadBinary(simulation, path) : loadText(simulation, path);
+}
+
+bool Catalog::loadText(Simulation& simulation, const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cout << "Failed to open catalog " << path << std::endl;
+        return false;
+    }
+
+    //Parents are matched by name once every line has been read, so order does not matter
+    std::vector<std::string> names, parentNames;
+    std::vector<int> parents;
+    std::vector<float> orbitRadii, speeds, startAngles, radii;
+    std::vector<double> masses;
+    std::vector<Color> colors;
+    std::vector<unsigned char> flags;
+    std::vector<OrbitShape> shapes;
+    bool anyShape = false;
+
+    std::string line;
+    unsigned int lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.erase(comment);
+        }
+        std::istringstream fields(line);
+        std::string name, parentName;
+        float orbitRadius, speed, radius;
+        double mass;
+        Color color;
+        if (!(fields >> name)) {
+            continue;
+        }
+        if (!(fields >> parentName >> orbitRadius >> speed >> radius >> mass >> color.r >> color.g >> color.b)) {
+            std::cout << path << ":" << lineNumber << ": expected name parent orbitRadius angularSpeed radius massKg r g b" << std::endl;
+            return false;
+        }
+        unsigned char flag = 0;
+        float startAngle = 0.0f;
+        OrbitShape shape = {};
+        std::string extra;
+        while (fields >> extra) {
+            size_t equals = extra.find('=');
+            std::string key = equals == std::string::npos ? "" : extra.substr(0, equals);
+            //Only a value that parses completely counts, so a typo never quietly becomes 0
+            const char* text = extra.c_str() + (equals == std::string::npos ? 0 : equals + 1);
+            char* end = nullptr;
+            float value = std::strtof(text, &end);
+            bool numeric = end != text && *end == '\0';
+            if (extra == "star") {
+                flag |= 1;
+                continue;
+            }
+            if (!numeric) {
+                std::cout << path << ":" << lineNumber << ": " << (key.empty() ? "unknown field " : "expected a number in ") << extra << std::endl;
+                return false;
+            }
+            if (key.empty()) {
+                startAngle = value;
+            }
+            else if (key == "e") {
+                shape.eccentricity = value;
+            }
+            else if (key == "i") {
+                shape.inclination = value;
+            }
+            else if (key == "node") {
+                shape.ascendingNode = value;
+            }
+            else if (key == "peri") {
+                shape.argumentOfPeriapsis = value;
+            }
+            else {
+                std::cout << path << ":" << lineNumber << ": unknown field " << extra << std::endl;
+                return false;
+            }
+        }
+        anyShape = anyShape || shape.eccentricity != 0.0f || shape.inclination != 0.0f || shape.ascendingNode != 0.0f || shape.argumentOfPeriapsis != 0.0f;
+
+        names.push_back(name);
+        parentNames.push_back(parentName);
+        orbitRadii.push_back(orbitRadius);
+        speeds.push_back(speed);
+        startAngles.push_back(startAngle);
+        radii.push_back(radius);
+        masses.push_back(mass);
+        colors.push_back(color);
+        flags.push_back(flag);
+        shapes.push_back(shape);
+    }
+
+    std::map<std::string, int> index;
+    for (unsigned int i = 0; i < names.size(); ++i) {
+        index[names[i]] = i;
+    }
+    parents.resize(names.size());
+    for (unsigned int i = 0; i < names.size(); ++i) {
+        if (parentNames[i] == "-") {
+            parents[i] = -1;
+            continue;
+        }
+        auto found = index.find(parentNames[i]);
+        if (found == index.end()) {
+            std::cout << path << ": " << names[i] << " orbits unknown body " << parentNames[i] << std::endl;
+            return false;
+        }
+        parents[i] = found->second;
+    }
+
+    simulation.appendBodies(names.size(), parents.data(), orbitRadii.data(), speeds.data(), startAngles.data(), radii.data(), masses.data(), colors.data(), flags.data(), anyShape ? shapes.data() : nullptr);
+    //Places everything without moving it
+    simulation.getBodies().setTime(simulation.getTime());
+    return true;
+}
+
+bool Catalog::loadBinary(Simulation& simulation, const std::string& path) {
+    MappedFile file;
+    if (!file.open(path)) {
+        std::cout << "Failed to map catalog " << path << std::endl;
+        return false;
+    }
+    const unsigned char* data = file.getData();
+    //The version 1 header first; it is all a version 1 file needs
+    if (file.size() < offsetof(CatalogHeader, shapeOffset)) {
+        std::cout << "Catalog " << path << " is too small" << std::endl;
+        return false;
+    }
+    CatalogHeader header = {};
+    std::memcpy(&header, data, offsetof(CatalogHeader, shapeOffset));
+    if (std::memcmp(header.magic, CATALOG_MAGIC, sizeof(CATALOG_MAGIC)) != 0 || header.version < 1 || header.version > VERSION) {
+        std::cout << "Catalog " << path << " has an unknown format or version" << std::endl;
+        return false;
+    }
+    //Later versions only add fields to the end of the header
+    if (header.version >= 2) {
+        if (file.size() < sizeof(header)) {
+            std::cout << "Catalog " << path << " is too small" << std::endl;
+            return false;
+        }
+        std::memcpy(&header, data, sizeof(header));
+    }
+
+    //Every array has to lie inside the file before anything is read from it
+    uint64_t count = header.count;
+    uint64_t offsets[9] = { header.parentOffset, header.orbitRadiusOffset, header.angularSpeedOffset, header.startAngleOffset,
+        header.radiusOffset, header.massOffset, header.colorOffset, header.flagsOffset, header.shapeOffset };
+    uint64_t sizes[9] = { count * sizeof(int32_t), count * sizeof(float), count * sizeof(float), count * sizeof(float),
+        count * sizeof(float), count * sizeof(double), count * sizeof(Color), count, header.shapeOffset != 0 ? count * sizeof(OrbitShape) : 0 };
+    for (unsigned int i = 0; i < 9; ++i) {
+        if (offsets[i] > file.size() || sizes[i] > file.size() - offsets[i] || offsets[i] % 8 != 0) {
+            std::cout << "Catalog " << path << " is truncated or corrupt" << std::endl;
+            return false;
+        }
+    }
+
+    simulation.reserve(simulation.size() + header.count);
+    simulation.appendBodies(header.count,
+        (const int*)(data + header.parentOffset),
+        (const float*)(data + header.orbitRadiusOffset),
+        (const float*)(data + header.angularSpeedOffset),
+        (const float*)(data + header.startAngleOffset),
+        (const float*)(data + header.radiusOffset),
+        (const double*)(data + header.massOffset),
+        (const Color*)(data + header.colorOffset),
+        data + header.flagsOffset,
+        header.shapeOffset != 0 ? (const OrbitShape*)(data + header.shapeOffset) : nullptr);
+    simulation.getBodies().setTime(simulation.getTime());
+    return true;
+}
+
+static uint64_t alignTo8(uint64_t offset) {
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+bool Catalog::saveBinary(const Simulation& simulation, const std::string& path) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cout << "Failed to write catalog " << path << std::endl;
+        return false;
+    }
+
+    unsigned int count = simulation.size();
+    const BodyStore& bodies = simulation.getBodies();
+    std::vector<int32_t> parents(count);
+    std::vector<float> orbitRadii(count), speeds(count), startAngles(count), radii(count);
+    std::vector<double> masses(count);
+    std::vector<Color> colors(count);
+    std::vector<unsigned char> flags(count);
+    std::vector<OrbitShape> shapes(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        parents[i] = bodies.getParent(i);
+        orbitRadii[i] = bodies.getOrbitRadius(i);
+        speeds[i] = bodies.getAngularSpeed(i);
+        startAngles[i] = bodies.getAngle(i);
+        radii[i] = simulation.getRadius(i);
+        masses[i] = simulation.getMassKg(i);
+        colors[i] = simulation.getColor(i);
+        flags[i] = simulation.isStar(i) ? 1 : 0;
+        shapes[i] = bodies.getShape(i);
+    }
+
+    CatalogHeader header = {};
+    std::memcpy(header.magic, CATALOG_MAGIC, sizeof(CATALOG_MAGIC));
+    header.version = VERSION;
+    header.count = count;
+    uint64_t offset = alignTo8(sizeof(CatalogHeader));
+    header.parentOffset = offset;       offset = alignTo8(offset + count * sizeof(int32_t));
+    header.orbitRadiusOffset = offset;  offset = alignTo8(offset + count * sizeof(float));
+    header.angularSpeedOffset = offset; offset = alignTo8(offset + count * sizeof(float));
+    header.startAngleOffset = offset;   offset = alignTo8(offset + count * sizeof(float));
+    header.radiusOffset = offset;       offset = alignTo8(offset + count * sizeof(float));
+    header.massOffset = offset;         offset = alignTo8(offset + count * sizeof(double));
+    header.colorOffset = offset;        offset = alignTo8(offset + count * sizeof(Color));
+    header.flagsOffset = offset;        offset = alignTo8(offset + count);
+    header.shapeOffset = offset;
+
+    //Writes one array and pads up to where the next one starts
+    uint64_t written = 0;
+    auto writeArray = [&file, &written](uint64_t at, const void* values, uint64_t bytes) {
+        static const char padding[8] = {};
+        file.write(padding, at - written);
+        file.write((const char*)values, bytes);
+        written = at + bytes;
+    };
+    writeArray(0, &header, sizeof(header));
+    writeArray(header.parentOffset, parents.data(), count * sizeof(int32_t));
+    writeArray(header.orbitRadiusOffset, orbitRadii.data(), count * sizeof(float));
+    writeArray(header.angularSpeedOffset, speeds.data(), count * sizeof(float));
+    writeArray(header.startAngleOffset, startAngles.data(), count * sizeof(float));
+    writeArray(header.radiusOffset, radii.data(), count * sizeof(float));
+    writeArray(header.massOffset, masses.data(), count * sizeof(double));
+    writeArray(header.colorOffset, colors.data(), count * sizeof(Color));
+    writeArray(header.flagsOffset, flags.data(), count);
+    writeArray(header.shapeOffset, shapes.data(), count * sizeof(OrbitShape));
+    return (bool)file;
+}
@@ -0,0 +1,48 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <string>
+#include <cstdint>
+#include "Simulation.h"
+
+//Loads bodies into a Simulation from a file instead of hard-coding them.
+//
+//Text format (small, hand-edited scenes), one body per line, '#' starts a comment:
+//  name parent orbitRadius angularSpeed radius massKg r g b [star] [startAngle] [e=E] [i=I] [node=N] [peri=W]
+//where parent is the name of an earlier or later body, or '-' to orbit the origin.
+//orbitRadius is the semi-major axis; the optional orbit shape angles are in radians (see OrbitShape).
+//See solar_system.txt.
+//
+//Binary format (large catalogs): a CatalogHeader followed by one array per field, each
+//8-byte aligned. The file is memory-mapped and each array is copied straight into the
+//simulation's own arrays, with no per-record parsing or allocation.
+class Catalog {
+public:
+	struct CatalogHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t count;
+		//Byte offsets from the start of the file
+		uint64_t parentOffset;			//int32 per body, relative to the first body, -1 for the origin
+		uint64_t orbitRadiusOffset;		//float
+		uint64_t angularSpeedOffset;	//float, radians per second
+		uint64_t startAngleOffset;		//float, radians
+		uint64_t radiusOffset;			//float
+		uint64_t massOffset;			//double, kg
+		uint64_t colorOffset;			//3 floats
+		uint64_t flagsOffset;			//uint8, bit 0 = star
+		uint64_t shapeOffset;			//OrbitShape (4 floats); version 2 on, 0 means every orbit is a circle
+	};
+	//Version 1 files have no shapeOffset and are still read
+	static const uint32_t VERSION = 2;
+	//Picks the format from the file's first bytes
+	static bool load(Simulation& simulation, const std::string& path);
+	static bool loadText(Simulation& simulation, const std::string& path);
+	static bool loadBinary(Simulation& simulation, const std::string& path);
+	//Writes every body with its current mean anomaly as the start angle
+	static bool saveBinary(const Simulation& simulation, const std::string& path);
+private:
+	static bool isBinary(const std::string& path);
+};
+
+#endif
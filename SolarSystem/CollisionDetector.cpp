@@ -0,0 +1,436 @@
+#include <cmath>
+#include <algorithm>
+#include "CollisionDetector.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+
+//Bodies sampled to pick a level's cell size, and the fraction of them that must fit in a cell
+static const size_t SIZE_SAMPLES = 1024;
+static const float GRID_PERCENTILE = 0.99f;
+
+CollisionDetector::CollisionDetector() {
+    approachDistance = 0.0f;
+    previousTime = 0.0;
+    hasPrevious = false;
+    levelCount = 0;
+    updateCount = 0;
+    stats = Stats();
+}
+
+void CollisionDetector::reset() {
+    hasPrevious = false;
+    previous.clear();
+    encounters.clear();
+}
+
+bool CollisionDetector::sweep(Vector3 a0, Vector3 a1, Vector3 b0, Vector3 b1, float contactDistance, float& closestS, float& closestDistance, float& contactS) {
+    //b relative to a: p(s) = p + d * s for s in [0, 1]
+    double px = (double)b0.x - a0.x, py = (double)b0.y - a0.y, pz = (double)b0.z - a0.z;
+    double dx = ((double)b1.x - a1.x) - px, dy = ((double)b1.y - a1.y) - py, dz = ((double)b1.z - a1.z) - pz;
+    double dd = dx * dx + dy * dy + dz * dz;
+    double pd = px * dx + py * dy + pz * dz;
+    double pp = px * px + py * py + pz * pz;
+    double s = dd > 0.0 ? std::min(1.0, std::max(0.0, -pd / dd)) : 0.0;
+    double cx = px + dx * s, cy = py + dy * s, cz = pz + dz * s;
+    double closest = std::sqrt(cx * cx + cy * cy + cz * cz);
+    closestS = (float)s;
+    closestDistance = (float)closest;
+
+    double range = contactDistance;
+    if (closest > range) {
+        return false;
+    }
+    if (pp <= range * range) {
+        contactS = 0.0f;
+        return true;
+    }
+    //First root of |p + d * s|^2 = range^2; dd > 0 here, or the start would have been in range
+    double discriminant = std::max(0.0, pd * pd - dd * (pp - range * range));
+    contactS = (float)std::min(1.0, std::max(0.0, (-pd - std::sqrt(discriminant)) / dd));
+    return true;
+}
+
+void CollisionDetector::buildBoxes(const Vector3* positions, const float* radii, unsigned int count) {
+    boxes.resize(count);
+    float grow = approachDistance * 0.5f;
+    JobSystem::parallelFor(count, BOX_CHUNK, [this, positions, radii, grow](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; ++i) {
+            const float* from = &previous[i].x;
+            const float* to = &positions[i].x;
+            float margin = radii[i] + grow;
+            for (unsigned int axis = 0; axis < 3; ++axis) {
+                boxes[i].min[axis] = std::min(from[axis], to[axis]) - margin;
+                boxes[i].max[axis] = std::max(from[axis], to[axis]) + margin;
+            }
+        }
+    });
+}
+
+//Splits candidates into the bodies that fit this level's cells and the rest. Each axis of the cell is
+//the sampled percentile box along it, then shrunk to the biggest member; orbits in a common plane
+//sweep boxes far thinner across it than along it
+void CollisionDetector::chooseCellSize(Level& level, const std::vector<unsigned int>& candidates, std::vector<unsigned int>& rest) {
+    std::vector<float> sample;
+    size_t stride = std::max((size_t)1, candidates.size() / SIZE_SAMPLES);
+    float limit[3];
+    for (unsigned int axis = 0; axis < 3; ++axis) {
+        sample.clear();
+        for (size_t n = 0; n < candidates.size(); n += stride) {
+            const Box& box = boxes[candidates[n]];
+            sample.push_back(box.max[axis] - box.min[axis]);
+        }
+        size_t rank = std::min(sample.size() - 1, (size_t)(sample.size() * GRID_PERCENTILE));
+        std::nth_element(sample.begin(), sample.begin() + rank, sample.end());
+        limit[axis] = sample[rank];
+    }
+
+    level.bodies.clear();
+    rest.clear();
+    float biggest[3] = { 0.0f, 0.0f, 0.0f };
+    for (unsigned int body : candidates) {
+        const Box& box = boxes[body];
+        if (box.max[0] - box.min[0] > limit[0] || box.max[1] - box.min[1] > limit[1] || box.max[2] - box.min[2] > limit[2]) {
+            rest.push_back(body);
+            continue;
+        }
+        level.bodies.push_back(body);
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            biggest[axis] = std::max(biggest[axis], box.max[axis] - box.min[axis]);
+        }
+    }
+    for (unsigned int axis = 0; axis < 3; ++axis) {
+        level.cellSize[axis] = biggest[axis] > 0.0f ? biggest[axis] : 1.0f;
+    }
+}
+
+long long CollisionDetector::cell(const Level& level, float coordinate, unsigned int axis) {
+    return (long long)std::floor(coordinate / level.cellSize[axis]);
+}
+
+//Cells along x get consecutive buckets, so the cells either side of a body are one contiguous run of slots
+uint64_t CollisionDetector::bucket(const Level& level, long long x, long long y, long long z) {
+    uint64_t h = (uint64_t)y * 0xC2B2AE3D27D4EB4Full ^ (uint64_t)z * 0x165667B19E3779F9ull;
+    return ((h ^ (h >> 29)) + (uint64_t)x) & level.bucketMask;
+}
+
+//Counting sort of the level's bodies by bucket, with their boxes copied alongside for the search
+void CollisionDetector::buildGrid(Level& level) {
+    unsigned int count = level.bodies.size();
+    uint64_t buckets = 1024;
+    while (buckets < 2ull * count) {
+        buckets *= 2;
+    }
+    level.bucketMask = buckets - 1;
+    bucketOf.resize(count);
+    JobSystem::parallelFor(count, BOX_CHUNK, [this, &level](unsigned int begin, unsigned int end) {
+        for (unsigned int n = begin; n < end; ++n) {
+            const Box& box = boxes[level.bodies[n]];
+            long long x = cell(level, (box.min[0] + box.max[0]) * 0.5f, 0);
+            long long y = cell(level, (box.min[1] + box.max[1]) * 0.5f, 1);
+            long long z = cell(level, (box.min[2] + box.max[2]) * 0.5f, 2);
+            bucketOf[n] = (uint32_t)bucket(level, x, y, z);
+        }
+    });
+
+    level.bucketStart.assign(buckets + 1, 0);
+    for (unsigned int n = 0; n < count; ++n) {
+        ++level.bucketStart[bucketOf[n] + 1];
+    }
+    for (uint64_t k = 0; k < buckets; ++k) {
+        level.bucketStart[k + 1] += level.bucketStart[k];
+    }
+    //Each bucket's start counts up to its end as it fills, so everything is shifted back one bucket afterwards
+    std::vector<unsigned int> unsorted = level.bodies;
+    level.boxes.resize(count);
+    for (unsigned int n = 0; n < count; ++n) {
+        uint32_t slot = level.bucketStart[bucketOf[n]]++;
+        level.bodies[slot] = unsorted[n];
+        level.boxes[slot] = boxes[unsorted[n]];
+    }
+    for (uint64_t k = buckets; k > 0; --k) {
+        level.bucketStart[k] = level.bucketStart[k - 1];
+    }
+    level.bucketStart[0] = 0;
+}
+
+//The 99% smallest boxes make level 0, the 99% smallest of the rest level 1 and so on,
+//until too few bodies are left for a grid to pay
+void CollisionDetector::buildLevels(unsigned int count) {
+    std::vector<unsigned int> candidates(count), rest;
+    for (unsigned int i = 0; i < count; ++i) {
+        candidates[i] = i;
+    }
+    levelCount = 0;
+    while (candidates.size() > MIN_GRID_BODIES && levelCount < MAX_LEVELS) {
+        if (levels.size() <= levelCount) {
+            levels.emplace_back();
+        }
+        Level& level = levels[levelCount];
+        chooseCellSize(level, candidates, rest);
+        if (level.bodies.empty()) {
+            break;
+        }
+        buildGrid(level);
+        ++levelCount;
+        candidates.swap(rest);
+    }
+    large.swap(candidates);
+}
+
+//Nearly every box tested misses, so all six comparisons are made without branching
+static bool overlaps(const float* aMin, const float* aMax, const float* bMin, const float* bMax) {
+    return (aMin[0] <= bMax[0]) & (bMin[0] <= aMax[0]) & (aMin[1] <= bMax[1]) & (bMin[1] <= aMax[1]) & (aMin[2] <= bMax[2]) & (bMin[2] <= aMax[2]);
+}
+
+void CollisionDetector::testPair(unsigned int a, unsigned int b, const Vector3* positions, const float* radii, std::vector<Hit>& hits, unsigned long long& candidates) const {
+    ++candidates;
+    if (a > b) {
+        std::swap(a, b);
+    }
+    float touching = radii[a] + radii[b];
+    Hit hit;
+    hit.a = a;
+    hit.b = b;
+    hit.contact = sweep(previous[a], positions[a], previous[b], positions[b], touching, hit.closestS, hit.closestDistance, hit.contactS);
+    if (hit.closestDistance - touching >= approachDistance && !hit.contact) {
+        return;
+    }
+    hit.contactDistance = touching;
+    if (hit.contact && hit.contactS == 0.0f) {
+        //Already overlapping at the start of the interval
+        float dx = previous[b].x - previous[a].x, dy = previous[b].y - previous[a].y, dz = previous[b].z - previous[a].z;
+        hit.contactDistance = std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+    hits.push_back(hit);
+}
+
+//Slot ranges holding the cells low..high, one run of buckets per row along x. Rows can hash onto
+//overlapping buckets, so the runs are merged to never visit a slot twice
+void CollisionDetector::gatherRuns(const Level& level, const long long* low, const long long* high, std::vector<Run>& runs) {
+    runs.clear();
+    uint64_t width = (uint64_t)(high[0] - low[0] + 1);
+    if (width > level.bucketMask) {
+        runs.push_back(Run{ 0, level.bodies.size() });
+        return;
+    }
+    for (long long y = low[1]; y <= high[1]; ++y) {
+        for (long long z = low[2]; z <= high[2]; ++z) {
+            uint64_t first = bucket(level, low[0], y, z);
+            uint64_t last = first + width;
+            if (last <= level.bucketMask + 1) {
+                runs.push_back(Run{ first, last });
+            }
+            else {
+                runs.push_back(Run{ first, level.bucketMask + 1 });
+                runs.push_back(Run{ 0, last - level.bucketMask - 1 });
+            }
+        }
+    }
+    std::sort(runs.begin(), runs.end(), [](const Run& x, const Run& y) { return x.begin < y.begin; });
+    size_t merged = 0;
+    for (size_t n = 1; n < runs.size(); ++n) {
+        if (runs[n].begin <= runs[merged].end) {
+            runs[merged].end = std::max(runs[merged].end, runs[n].end);
+        }
+        else {
+            runs[++merged] = runs[n];
+        }
+    }
+    runs.resize(merged + 1);
+    for (Run& run : runs) {
+        run.begin = level.bucketStart[run.begin];
+        run.end = level.bucketStart[run.end];
+    }
+}
+
+//Tests a body from a coarser level (or a large one) against every body of this level its box can reach.
+//The grid's boxes reach at most half a cell beyond the cell holding their centre
+void CollisionDetector::searchFiner(const Level& level, unsigned int body, const Vector3* positions, const float* radii, std::vector<Run>& runs, std::vector<Hit>& hits, unsigned long long& candidates) const {
+    const Box& box = boxes[body];
+    long long low[3], high[3];
+    double cells = 1.0;
+    for (unsigned int axis = 0; axis < 3; ++axis) {
+        low[axis] = cell(level, box.min[axis], axis) - 1;
+        high[axis] = cell(level, box.max[axis], axis) + 1;
+        cells *= (double)(high[axis] - low[axis] + 1);
+    }
+    runs.clear();
+    if (cells >= (double)level.bodies.size()) {
+        //Fewer bodies than cells: reading them all is cheaper
+        runs.push_back(Run{ 0, level.bodies.size() });
+    }
+    else {
+        gatherRuns(level, low, high, runs);
+    }
+    for (const Run& run : runs) {
+        for (uint64_t slot = run.begin; slot < run.end; ++slot) {
+            if (overlaps(box.min, box.max, level.boxes[slot].min, level.boxes[slot].max)) {
+                testPair(body, level.bodies[slot], positions, radii, hits, candidates);
+            }
+        }
+    }
+}
+
+//Pairs within a level are found once, from the body with the lower id, and pairs across levels from
+//the coarser one. Slots are in bucket order, so consecutive bodies mostly share rows and the runs
+//they read are still in cache
+void CollisionDetector::searchLevel(unsigned int levelIndex, unsigned int begin, unsigned int end, const Vector3* positions, const float* radii, std::vector<Hit>& hits, unsigned long long& candidates) const {
+    const Level& level = levels[levelIndex];
+    std::vector<Run> runs, finerRuns;
+    long long centre[3] = { 0, 0, 0 };
+    for (unsigned int slot = begin; slot < end; ++slot) {
+        unsigned int body = level.bodies[slot];
+        const Box& box = level.boxes[slot];
+        long long here[3];
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            here[axis] = cell(level, (box.min[axis] + box.max[axis]) * 0.5f, axis);
+        }
+        //Bodies in the same cell are next to each other and read the same runs
+        if (slot == begin || here[0] != centre[0] || here[1] != centre[1] || here[2] != centre[2]) {
+            long long low[3], high[3];
+            for (unsigned int axis = 0; axis < 3; ++axis) {
+                centre[axis] = here[axis];
+                low[axis] = here[axis] - 1;
+                high[axis] = here[axis] + 1;
+            }
+            gatherRuns(level, low, high, runs);
+        }
+        for (const Run& run : runs) {
+            for (uint64_t other = run.begin; other < run.end; ++other) {
+                if (overlaps(box.min, box.max, level.boxes[other].min, level.boxes[other].max) && level.bodies[other] > body) {
+                    testPair(body, level.bodies[other], positions, radii, hits, candidates);
+                }
+            }
+        }
+        for (unsigned int finer = 0; finer < levelIndex; ++finer) {
+            searchFiner(levels[finer], body, positions, radii, finerRuns, hits, candidates);
+        }
+    }
+}
+
+//Large bodies are few: each is tested against every level and the large bodies after it
+void CollisionDetector::searchLarge(unsigned int body, const Vector3* positions, const float* radii, std::vector<Hit>& hits, unsigned long long& candidates) const {
+    std::vector<Run> runs;
+    for (unsigned int level = 0; level < levelCount; ++level) {
+        searchFiner(levels[level], body, positions, radii, runs, hits, candidates);
+    }
+    const Box& box = boxes[body];
+    for (unsigned int other : large) {
+        if (other > body && overlaps(box.min, box.max, boxes[other].min, boxes[other].max)) {
+            testPair(body, other, positions, radii, hits, candidates);
+        }
+    }
+}
+
+//Folds this interval's hits into the open encounters; any encounter without a hit has ended
+void CollisionDetector::mergeHits(double startTime, double endTime) {
+    size_t firstEvent = events.size();
+    double span = endTime - startTime;
+    for (const std::vector<Hit>& hits : chunkHits) {
+        for (const Hit& hit : hits) {
+            uint64_t key = (uint64_t)hit.a << 32 | hit.b;
+            double closestTime = startTime + span * hit.closestS;
+            auto found = encounters.find(key);
+            if (found == encounters.end()) {
+                found = encounters.emplace(key, Encounter{ closestTime, hit.closestDistance, 0, false }).first;
+            }
+            Encounter& encounter = found->second;
+            if (hit.closestDistance < encounter.distance) {
+                encounter.time = closestTime;
+                encounter.distance = hit.closestDistance;
+            }
+            encounter.lastUpdate = updateCount;
+            if (hit.contact && !encounter.collided) {
+                encounter.collided = true;
+                events.push_back(CollisionEvent{ CollisionEvent::COLLISION, hit.a, hit.b, startTime + span * hit.contactS, hit.contactDistance });
+            }
+        }
+    }
+
+    for (auto it = encounters.begin(); it != encounters.end();) {
+        if (it->second.lastUpdate != updateCount) {
+            events.push_back(CollisionEvent{ CollisionEvent::APPROACH, (unsigned int)(it->first >> 32), (unsigned int)it->first, it->second.time, it->second.distance });
+            it = encounters.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+
+    std::sort(events.begin() + firstEvent, events.end(), [](const CollisionEvent& x, const CollisionEvent& y) {
+        return x.time != y.time ? x.time < y.time : (x.a != y.a ? x.a < y.a : x.b < y.b);
+    });
+    stats.events += events.size() - firstEvent;
+}
+
+void CollisionDetector::update(const Vector3* positions, const float* radii, unsigned int count, double time) {
+    PROFILE_SCOPE("collisions");
+    if (!hasPrevious || previous.size() != count) {
+        //Nothing to sweep from: the interval is just this instant
+        encounters.clear();
+        previous.assign(positions, positions + count);
+        previousTime = time;
+        hasPrevious = true;
+    }
+    ++updateCount;
+
+    buildBoxes(positions, radii, count);
+    buildLevels(count);
+
+    //One hit list per chunk of each level, then one per large body
+    std::vector<unsigned int> firstChunk(levelCount + 1, 0);
+    for (unsigned int level = 0; level < levelCount; ++level) {
+        firstChunk[level + 1] = firstChunk[level] + (unsigned int)((levels[level].bodies.size() + SEARCH_CHUNK - 1) / SEARCH_CHUNK);
+    }
+    unsigned int largeChunk = firstChunk[levelCount];
+    chunkHits.resize(largeChunk + large.size());
+    chunkCandidates.assign(largeChunk + large.size(), 0);
+    for (std::vector<Hit>& hits : chunkHits) {
+        hits.clear();
+    }
+    for (unsigned int level = 0; level < levelCount; ++level) {
+        unsigned int first = firstChunk[level];
+        JobSystem::parallelFor(levels[level].bodies.size(), SEARCH_CHUNK, [this, positions, radii, level, first](unsigned int begin, unsigned int end) {
+            unsigned int chunk = first + begin / SEARCH_CHUNK;
+            searchLevel(level, begin, end, positions, radii, chunkHits[chunk], chunkCandidates[chunk]);
+        });
+    }
+    JobSystem::parallelFor(large.size(), 1, [this, positions, radii, largeChunk](unsigned int begin, unsigned int end) {
+        for (unsigned int n = begin; n < end; ++n) {
+            searchLarge(large[n], positions, radii, chunkHits[largeChunk + n], chunkCandidates[largeChunk + n]);
+        }
+    });
+
+    mergeHits(previousTime, time);
+    previous.assign(positions, positions + count);
+    previousTime = time;
+
+    stats.bodies = count;
+    stats.levels = levelCount;
+    stats.largeBodies = large.size();
+    for (unsigned int axis = 0; axis < 3; ++axis) {
+        stats.cellSize[axis] = levelCount > 0 ? levels[0].cellSize[axis] : 0.0f;
+    }
+    stats.candidates = 0;
+    stats.hits = 0;
+    for (unsigned int n = 0; n < chunkHits.size(); ++n) {
+        stats.candidates += chunkCandidates[n];
+        stats.hits += chunkHits[n].size();
+    }
+    stats.openEncounters = encounters.size();
+}
+
+void CollisionDetector::flush() {
+    //Every open encounter ends now: no hits this round
+    ++updateCount;
+    for (std::vector<Hit>& hits : chunkHits) {
+        hits.clear();
+    }
+    mergeHits(previousTime, previousTime);
+    stats.openEncounters = 0;
+}
+
+void CollisionDetector::takeEvents(std::vector<CollisionEvent>& out) {
+    out.insert(out.end(), events.begin(), events.end());
+    events.clear();
+}
@@ -0,0 +1,140 @@
+#ifndef COLLISIONDETECTOR_H
+#define COLLISIONDETECTOR_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "BodyTypes.h"
+
+//One entry in the stream of encounters between two bodies (a < b)
+struct CollisionEvent {
+	enum Type : unsigned char {
+		APPROACH,	//An encounter closer than the approach distance has ended; time and distance are its closest point
+		COLLISION	//The two bodies have just touched; time is the first contact
+	};
+	Type type;
+	unsigned int a, b;
+	double time;
+	//Centre to centre distance at that time
+	float distance;
+};
+
+//Close-approach and collision detection between every pair of bodies, without testing every pair.
+//
+//Each update covers the interval since the last one. A body's swept box is its bounding box at both
+//ends of the interval, grown by its radius and half the approach distance, so two bodies can only
+//come close if their boxes overlap. Boxes are hashed by centre into uniform grids (a counting sort
+//over hash buckets, rebuilt every update) with cells as big as the largest box in the grid, so a box
+//can only overlap boxes in the 27 cells around its own. One grid cannot suit the sun and a pebble, so
+//there is a grid per size class: level 0 holds the 99% smallest boxes, level 1 the 99% smallest of
+//the rest and so on, each body also reading the cells its box covers in every finer level. The last
+//few bodies (the sun, the planets) are tested against all the levels and each other. Candidate
+//pairs then get an exact test assuming straight-line motion across the interval: the closest
+//distance and, if they touch, the time of first contact.
+//
+//Encounters are tracked while they last, so a long pass produces one APPROACH event at its closest
+//point rather than one per step. Has no OpenGL dependency; the Simulation runs it after every step.
+class CollisionDetector {
+public:
+	struct Stats {
+		unsigned int bodies;
+		unsigned int levels;
+		//Bodies in no grid, tested against all of them
+		unsigned int largeBodies;
+		//Cell of level 0, the smallest
+		float cellSize[3];
+		//Pairs whose swept boxes overlapped, and those the exact test found within the approach distance
+		unsigned long long candidates;
+		unsigned long long hits;
+		unsigned int openEncounters;
+		unsigned long long events;
+	};
+private:
+	struct Box {
+		float min[3], max[3];
+	};
+	//A pair the exact test found close during the last interval; s runs 0..1 across it
+	struct Hit {
+		unsigned int a, b;
+		float closestS, closestDistance;
+		float contactS, contactDistance;
+		bool contact;
+	};
+	//One grid: bodies sorted by bucket, bucketStart[k] .. bucketStart[k + 1] in bucket k
+	struct Level {
+		float cellSize[3];
+		uint64_t bucketMask;
+		std::vector<uint32_t> bucketStart;
+		std::vector<unsigned int> bodies;
+		std::vector<Box> boxes;
+	};
+	//Slots begin .. end of a level
+	struct Run {
+		uint64_t begin, end;
+	};
+	struct Encounter {
+		double time;
+		float distance;
+		unsigned long long lastUpdate;
+		bool collided;
+	};
+	float approachDistance;
+	//Positions at the end of the last update, the start of the next interval
+	std::vector<Vector3> previous;
+	double previousTime;
+	bool hasPrevious;
+	std::vector<Box> boxes;
+	//Kept between updates so their memory is reused; only the first levelCount are current
+	std::vector<Level> levels;
+	unsigned int levelCount;
+	std::vector<unsigned int> large;
+	std::vector<uint32_t> bucketOf;
+	//One list per grid chunk and per large body, merged in order so the result never depends on timing
+	std::vector<std::vector<Hit>> chunkHits;
+	std::vector<unsigned long long> chunkCandidates;
+	std::unordered_map<uint64_t, Encounter> encounters;
+	unsigned long long updateCount;
+	std::vector<CollisionEvent> events;
+	Stats stats;
+
+	void buildBoxes(const Vector3* positions, const float* radii, unsigned int count);
+	void chooseCellSize(Level& level, const std::vector<unsigned int>& candidates, std::vector<unsigned int>& rest);
+	void buildGrid(Level& level);
+	void buildLevels(unsigned int count);
+	static long long cell(const Level& level, float coordinate, unsigned int axis);
+	static uint64_t bucket(const Level& level, long long x, long long y, long long z);
+	static void gatherRuns(const Level& level, const long long* low, const long long* high, std::vector<Run>& runs);
+	void testPair(unsigned int a, unsigned int b, const Vector3* positions, const float* radii, std::vector<Hit>& hits, unsigned long long& candidates) const;
+	void searchFiner(const Level& level, unsigned int body, const Vector3* positions, const float* radii, std::vector<Run>& runs, std::vector<Hit>& hits, unsigned long long& candidates) const;
+	void searchLevel(unsigned int levelIndex, unsigned int begin, unsigned int end, const Vector3* positions, const float* radii, std::vector<Hit>& hits, unsigned long long& candidates) const;
+	void searchLarge(unsigned int body, const Vector3* positions, const float* radii, std::vector<Hit>& hits, unsigned long long& candidates) const;
+	void mergeHits(double startTime, double endTime);
+public:
+	//Grid bodies per job
+	static const unsigned int SEARCH_CHUNK = 4096;
+	//Bodies per job when swept boxes and bucket numbers are filled in
+	static const unsigned int BOX_CHUNK = 16384;
+	//Levels stop once this few bodies are left, or after MAX_LEVELS
+	static const unsigned int MIN_GRID_BODIES = 64;
+	static const unsigned int MAX_LEVELS = 8;
+	CollisionDetector();
+	//Surface to surface gap below which two bodies count as a close approach
+	void setApproachDistance(float distance) { approachDistance = distance; }
+	float getApproachDistance() const { return approachDistance; }
+	//Checks the interval from the last update to these positions at this time.
+	//The first update after a reset only checks the positions themselves.
+	void update(const Vector3* positions, const float* radii, unsigned int count, double time);
+	//Forgets the last positions and any open encounters without reporting them, e.g. after a jump in time
+	void reset();
+	//Reports every encounter still open as if it had ended now
+	void flush();
+	//Appends the events since the last call to out, oldest first
+	void takeEvents(std::vector<CollisionEvent>& out);
+	const Stats& getStats() const { return stats; }
+	//Exact test for two spheres moving in straight lines from a0/b0 to a1/b1. Returns the fraction of
+	//the way through of the closest point and its distance and, when they come within contactDistance,
+	//the fraction at which they first do (0 if they already were)
+	static bool sweep(Vector3 a0, Vector3 a1, Vector3 b0, Vector3 b1, float contactDistance, float& closestS, float& closestDistance, float& contactS);
+};
+
+#endif
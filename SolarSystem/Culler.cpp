@@ -0,0 +1,148 @@
+#include <cmath>
+#include <algorithm>
+#include "Culler.h"
+#include "JobSystem.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CULLER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+Culler::Culler() {
+    for (unsigned int p = 0; p < 6; ++p) {
+        planes[p][0] = planes[p][1] = planes[p][2] = 0.0f;
+        planes[p][3] = 1.0f;
+    }
+    depthRow[0] = depthRow[1] = depthRow[2] = 0.0f;
+    depthRow[3] = 1.0f;
+    pixelScale = 1.0f;
+    pixelThreshold = 1.0f;
+    impostors = true;
+    stats = Stats();
+}
+
+//Gribb-Hartmann: each plane is the bottom row of the matrix plus or minus one of the others
+void Culler::setCamera(const float* viewProjection, float projectionScaleY, float viewportHeight) {
+    float rows[4][4];
+    for (unsigned int r = 0; r < 4; ++r) {
+        for (unsigned int c = 0; c < 4; ++c) {
+            rows[r][c] = viewProjection[c * 4 + r];
+        }
+    }
+    for (unsigned int axis = 0; axis < 3; ++axis) {
+        for (unsigned int side = 0; side < 2; ++side) {
+            float* plane = planes[axis * 2 + side];
+            float sign = side == 0 ? 1.0f : -1.0f;
+            for (unsigned int c = 0; c < 4; ++c) {
+                plane[c] = rows[3][c] + sign * rows[axis][c];
+            }
+            float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+            if (length > 0.0f) {
+                for (unsigned int c = 0; c < 4; ++c) {
+                    plane[c] /= length;
+                }
+            }
+        }
+    }
+    for (unsigned int c = 0; c < 4; ++c) {
+        depthRow[c] = rows[3][c];
+    }
+    pixelScale = 0.5f * projectionScaleY * viewportHeight;
+}
+
+Culler::Class Culler::classify(Vector3 pos, float radius) const {
+    for (unsigned int p = 0; p < 6; ++p) {
+        if (planes[p][0] * pos.x + planes[p][1] * pos.y + planes[p][2] * pos.z + planes[p][3] < -radius) {
+            return CULLED;
+        }
+    }
+    float depth = depthRow[0] * pos.x + depthRow[1] * pos.y + depthRow[2] * pos.z + depthRow[3];
+    //radius * pixelScale / depth < threshold, without the division
+    return radius * pixelScale < pixelThreshold * depth ? POINT : MESH;
+}
+
+float Culler::projectedRadius(Vector3 pos, float radius) const {
+    float depth = depthRow[0] * pos.x + depthRow[1] * pos.y + depthRow[2] * pos.z + depthRow[3];
+    return depth > 0.0f ? radius * pixelScale / depth : 0.0f;
+}
+
+void Culler::classifyRangeScalar(const Vector3* positions, const float* radii, unsigned char* out, unsigned int begin, unsigned int end) const {
+    for (unsigned int i = begin; i < end; ++i) {
+        out[i] = classify(positions[i], radii[i]);
+    }
+}
+
+#ifdef CULLER_SSE2
+
+void Culler::classifyRange(const Vector3* positions, const float* radii, unsigned char* out, unsigned int begin, unsigned int end) const {
+    const __m128 scale = _mm_set1_ps(pixelScale);
+    const __m128 threshold = _mm_set1_ps(pixelThreshold);
+
+    unsigned int i = begin;
+    for (; i + 4 <= end; i += 4) {
+        //Four packed Vector3s are three registers: x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+        const float* base = &positions[i].x;
+        __m128 a = _mm_loadu_ps(base);
+        __m128 b = _mm_loadu_ps(base + 4);
+        __m128 c = _mm_loadu_ps(base + 8);
+        __m128 x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+        __m128 y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 radius = _mm_loadu_ps(radii + i);
+
+        //Smallest signed distance to any plane, plus the radius: negative means fully outside one of them
+        __m128 nearest = _mm_set1_ps(INFINITY);
+        for (unsigned int p = 0; p < 6; ++p) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(planes[p][0])), _mm_mul_ps(y, _mm_set1_ps(planes[p][1]))),
+                _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(planes[p][2])), _mm_set1_ps(planes[p][3])));
+            nearest = _mm_min_ps(nearest, distance);
+        }
+        int outside = _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(nearest, radius), _mm_setzero_ps()));
+
+        __m128 depth = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(depthRow[0])), _mm_mul_ps(y, _mm_set1_ps(depthRow[1]))),
+            _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(depthRow[2])), _mm_set1_ps(depthRow[3])));
+        int small = _mm_movemask_ps(_mm_cmplt_ps(_mm_mul_ps(radius, scale), _mm_mul_ps(threshold, depth)));
+
+        for (unsigned int lane = 0; lane < 4; ++lane) {
+            out[i + lane] = (outside >> lane & 1) ? CULLED : ((small >> lane & 1) ? POINT : MESH);
+        }
+    }
+    classifyRangeScalar(positions, radii, out, i, end);
+}
+
+#else
+
+void Culler::classifyRange(const Vector3* positions, const float* radii, unsigned char* out, unsigned int begin, unsigned int end) const {
+    classifyRangeScalar(positions, radii, out, begin, end);
+}
+
+#endif
+
+void Culler::cull(const Vector3* positions, const float* radii, unsigned int count, std::vector<unsigned int>& visible, std::vector<unsigned int>& points) {
+    classes.resize(count);
+    unsigned char* out = classes.data();
+    JobSystem::parallelFor(count, CULL_CHUNK, [this, positions, radii, out](unsigned int begin, unsigned int end) {
+        classifyRange(positions, radii, out, begin, end);
+    });
+
+    //Compaction is a single streaming pass over one byte per body
+    visible.clear();
+    points.clear();
+    stats = Stats();
+    stats.tested = count;
+    for (unsigned int i = 0; i < count; ++i) {
+        if (out[i] == MESH) {
+            visible.push_back(i);
+        }
+        else if (out[i] == POINT) {
+            ++stats.subPixel;
+            if (impostors) {
+                points.push_back(i);
+            }
+        }
+        else {
+            ++stats.outside;
+        }
+    }
+    stats.visible = visible.size();
+}
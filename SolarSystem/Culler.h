@@ -0,0 +1,60 @@
+#ifndef CULLER_H
+#define CULLER_H
+
+#include <vector>
+#include "BodyTypes.h"
+
+//Decides which bodies are worth drawing before anything is handed to the renderer.
+//
+//Each body's bounding sphere is tested against the six frustum planes, and its projected
+//radius in pixels is compared with a threshold: bodies outside the frustum are dropped, bodies
+//too small to see are dropped or drawn as single-pixel points, and only the rest make the mesh
+//draw list. Bodies are tested four at a time with SSE2 (scalar elsewhere), in chunks across the
+//job system. Has no OpenGL dependency so it can be benchmarked headless.
+class Culler {
+public:
+	struct Stats {
+		unsigned int tested;
+		unsigned int outside;
+		unsigned int subPixel;
+		unsigned int visible;
+	};
+	enum Class : unsigned char {
+		CULLED = 0,
+		MESH = 1,
+		POINT = 2
+	};
+private:
+	//a, b, c, d per plane with the normal pointing inwards and unit length, so a*x + b*y + c*z + d is a distance
+	float planes[6][4];
+	//Bottom row of the view-projection matrix: gives clip w, the distance in front of the camera
+	float depthRow[4];
+	//Pixels covered by one world unit at distance 1
+	float pixelScale;
+	float pixelThreshold;
+	bool impostors;
+	std::vector<unsigned char> classes;
+	Stats stats;
+	void classifyRange(const Vector3* positions, const float* radii, unsigned char* out, unsigned int begin, unsigned int end) const;
+	void classifyRangeScalar(const Vector3* positions, const float* radii, unsigned char* out, unsigned int begin, unsigned int end) const;
+public:
+	//Bodies per job
+	static const unsigned int CULL_CHUNK = 16384;
+	Culler();
+	//viewProjection is column-major, as glm stores it. projectionScaleY is projection[1][1]
+	//(1 / tan(fovY / 2)) and viewportHeight is in pixels.
+	void setCamera(const float* viewProjection, float projectionScaleY, float viewportHeight);
+	//Bodies with a projected radius below this many pixels count as sub-pixel
+	void setPixelThreshold(float pixels) { pixelThreshold = pixels; }
+	//true draws sub-pixel bodies as points, false drops them
+	void setImpostors(bool enabled) { impostors = enabled; }
+	//Writes the ids of bodies to draw as meshes to `visible` and, with impostors on, the sub-pixel ones to `points`
+	void cull(const Vector3* positions, const float* radii, unsigned int count, std::vector<unsigned int>& visible, std::vector<unsigned int>& points);
+	//The classification of a single body, for checking the batched path
+	Class classify(Vector3 pos, float radius) const;
+	//Radius in pixels of a sphere in front of the camera
+	float projectedRadius(Vector3 pos, float radius) const;
+	const Stats& getStats() const { return stats; }
+};
+
+#endif
@@ -0,0 +1,283 @@
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include "Ephemeris.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+
+static const char EPHEMERIS_MAGIC[8] = { 'S', 'S', 'E', 'P', 'H', 'E', 'M', '\0' };
+//Blocks start on a cache line
+static const uint64_t DATA_ALIGNMENT = 64;
+
+//T_0(x) .. T_degree(x) and their derivatives
+static void chebyshev(double x, unsigned int degree, double* values, double* slopes) {
+    values[0] = 1.0;
+    slopes[0] = 0.0;
+    if (degree > 0) {
+        values[1] = x;
+        slopes[1] = 1.0;
+    }
+    for (unsigned int k = 1; k < degree; ++k) {
+        values[k + 1] = 2.0 * x * values[k] - values[k - 1];
+        slopes[k + 1] = 2.0 * values[k] + 2.0 * x * slopes[k] - slopes[k - 1];
+    }
+}
+
+//Least squares fit of degree + 1 coefficients to samples evenly spaced over [-1, 1]:
+//the rows of (A^T A)^-1 A^T, where A[j][k] is T_k at sample j. basis gets A itself
+static bool buildFitMatrix(unsigned int samples, unsigned int degree, std::vector<double>& fit, std::vector<double>& basis) {
+    unsigned int terms = degree + 1;
+    basis.assign(samples * terms, 0.0);
+    std::vector<double> slopes(terms);
+    for (unsigned int j = 0; j < samples; ++j) {
+        chebyshev(-1.0 + 2.0 * j / (samples - 1), degree, &basis[j * terms], slopes.data());
+    }
+
+    //Gauss-Jordan on [A^T A | A^T]
+    unsigned int width = terms + samples;
+    std::vector<double> system(terms * width, 0.0);
+    for (unsigned int r = 0; r < terms; ++r) {
+        for (unsigned int c = 0; c < terms; ++c) {
+            for (unsigned int j = 0; j < samples; ++j) {
+                system[r * width + c] += basis[j * terms + r] * basis[j * terms + c];
+            }
+        }
+        for (unsigned int j = 0; j < samples; ++j) {
+            system[r * width + terms + j] = basis[j * terms + r];
+        }
+    }
+    for (unsigned int column = 0; column < terms; ++column) {
+        unsigned int pivot = column;
+        for (unsigned int r = column + 1; r < terms; ++r) {
+            if (std::fabs(system[r * width + column]) > std::fabs(system[pivot * width + column])) {
+                pivot = r;
+            }
+        }
+        if (std::fabs(system[pivot * width + column]) < 1e-12) {
+            return false;
+        }
+        for (unsigned int c = 0; c < width; ++c) {
+            std::swap(system[column * width + c], system[pivot * width + c]);
+        }
+        double scale = 1.0 / system[column * width + column];
+        for (unsigned int c = 0; c < width; ++c) {
+            system[column * width + c] *= scale;
+        }
+        for (unsigned int r = 0; r < terms; ++r) {
+            double factor = system[r * width + column];
+            if (r != column && factor != 0.0) {
+                for (unsigned int c = 0; c < width; ++c) {
+                    system[r * width + c] -= factor * system[column * width + c];
+                }
+            }
+        }
+    }
+    fit.resize(terms * samples);
+    for (unsigned int r = 0; r < terms; ++r) {
+        for (unsigned int j = 0; j < samples; ++j) {
+            fit[r * samples + j] = system[r * width + terms + j];
+        }
+    }
+    return true;
+}
+
+Ephemeris::Ephemeris() {
+    header = nullptr;
+    coefficients = nullptr;
+}
+
+bool Ephemeris::generate(Simulation& simulation, const std::string& path, unsigned int intervalCount, unsigned int intervalSteps, unsigned int sampleSteps, unsigned int degree) {
+    PROFILE_SCOPE("ephemeris generate");
+    if (intervalCount == 0 || sampleSteps == 0 || intervalSteps % sampleSteps != 0 || intervalSteps / sampleSteps < degree) {
+        std::cout << "Ephemeris needs at least degree + 1 samples per interval and a whole number of steps between them" << std::endl;
+        return false;
+    }
+    unsigned int samples = intervalSteps / sampleSteps + 1;
+    unsigned int terms = degree + 1;
+    std::vector<double> fit, basis;
+    if (!buildFitMatrix(samples, degree, fit, basis)) {
+        std::cout << "Ephemeris fit of degree " << degree << " to " << samples << " samples is singular" << std::endl;
+        return false;
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        std::cout << "Failed to write ephemeris " << path << std::endl;
+        return false;
+    }
+    unsigned int count = simulation.size();
+    EphemerisHeader fileHeader = {};
+    std::memcpy(fileHeader.magic, EPHEMERIS_MAGIC, sizeof(EPHEMERIS_MAGIC));
+    fileHeader.version = VERSION;
+    fileHeader.count = count;
+    fileHeader.degree = degree;
+    fileHeader.intervalCount = intervalCount;
+    fileHeader.startTime = simulation.getTime();
+    fileHeader.intervalLength = intervalSteps * simulation.getFixedStep();
+    fileHeader.dataOffset = (sizeof(EphemerisHeader) + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT;
+    static const char padding[DATA_ALIGNMENT] = {};
+    out.write((const char*)&fileHeader, sizeof(fileHeader));
+    out.write(padding, fileHeader.dataOffset - sizeof(fileHeader));
+
+    //Sample j of the current interval is frame j; the last one is also the next interval's first
+    std::vector<Vector3> frames((size_t)samples * count);
+    auto capture = [&simulation, &frames, count](unsigned int frame) {
+        Vector3* target = &frames[(size_t)frame * count];
+        JobSystem::parallelFor(count, CAPTURE_CHUNK, [&simulation, target](unsigned int begin, unsigned int end) {
+            for (unsigned int id = begin; id < end; ++id) {
+                target[id] = simulation.getPos(id);
+            }
+        });
+    };
+    //No steps, but leaves an N-body state to read if gravity has not been seeded yet
+    simulation.step(0);
+    capture(0);
+
+    std::vector<float> block((size_t)terms * 3 * count);
+    unsigned int chunks = (count + EVALUATE_CHUNK - 1) / EVALUATE_CHUNK;
+    std::vector<float> chunkError(chunks, 0.0f);
+    for (unsigned int interval = 0; interval < intervalCount; ++interval) {
+        for (unsigned int frame = 1; frame < samples; ++frame) {
+            simulation.step(sampleSteps);
+            capture(frame);
+        }
+
+        //Fit every body, then measure the stored (float) coefficients against the samples
+        JobSystem::parallelFor(count, EVALUATE_CHUNK, [&](unsigned int begin, unsigned int end) {
+            float worst = 0.0f;
+            std::vector<double> values(samples), coefficient(terms);
+            for (unsigned int id = begin; id < end; ++id) {
+                float offsets[3] = { 0.0f, 0.0f, 0.0f };
+                for (unsigned int axis = 0; axis < 3; ++axis) {
+                    for (unsigned int j = 0; j < samples; ++j) {
+                        values[j] = (&frames[(size_t)j * count + id].x)[axis];
+                    }
+                    for (unsigned int k = 0; k < terms; ++k) {
+                        double sum = 0.0;
+                        for (unsigned int j = 0; j < samples; ++j) {
+                            sum += fit[k * samples + j] * values[j];
+                        }
+                        float stored = (float)sum;
+                        block[((size_t)k * 3 + axis) * count + id] = stored;
+                        coefficient[k] = stored;
+                    }
+                    for (unsigned int j = 0; j < samples; ++j) {
+                        double fitted = 0.0;
+                        for (unsigned int k = 0; k < terms; ++k) {
+                            fitted += coefficient[k] * basis[j * terms + k];
+                        }
+                        offsets[axis] = std::max(offsets[axis], (float)std::fabs(fitted - values[j]));
+                    }
+                }
+                worst = std::max(worst, offsets[0] * offsets[0] + offsets[1] * offsets[1] + offsets[2] * offsets[2]);
+            }
+            chunkError[begin / EVALUATE_CHUNK] = std::max(chunkError[begin / EVALUATE_CHUNK], std::sqrt(worst));
+        });
+        out.write((const char*)block.data(), block.size() * sizeof(float));
+        std::copy(frames.end() - count, frames.end(), frames.begin());
+    }
+
+    for (float error : chunkError) {
+        fileHeader.maxFitError = std::max(fileHeader.maxFitError, error);
+    }
+    out.seekp(0);
+    out.write((const char*)&fileHeader, sizeof(fileHeader));
+    if (!out) {
+        std::cout << "Failed to write ephemeris " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Ephemeris::open(const std::string& path) {
+    close();
+    if (!file.open(path)) {
+        std::cout << "Failed to map ephemeris " << path << std::endl;
+        return false;
+    }
+    const EphemerisHeader* candidate = (const EphemerisHeader*)file.getData();
+    if (file.size() < sizeof(EphemerisHeader) || std::memcmp(candidate->magic, EPHEMERIS_MAGIC, sizeof(EPHEMERIS_MAGIC)) != 0 || candidate->version != VERSION) {
+        std::cout << path << " is not a version " << VERSION << " ephemeris" << std::endl;
+        file.close();
+        return false;
+    }
+    uint64_t blockBytes = (uint64_t)(candidate->degree + 1) * 3 * candidate->count * sizeof(float);
+    if (candidate->intervalCount == 0 || candidate->dataOffset % sizeof(float) != 0 || file.size() < candidate->dataOffset + candidate->intervalCount * blockBytes) {
+        std::cout << "Ephemeris " << path << " is truncated" << std::endl;
+        file.close();
+        return false;
+    }
+    header = candidate;
+    coefficients = (const float*)(file.getData() + header->dataOffset);
+    return true;
+}
+
+void Ephemeris::close() {
+    header = nullptr;
+    coefficients = nullptr;
+    file.close();
+}
+
+void Ephemeris::evaluate(double time, unsigned int first, unsigned int count, Vector3* positions, Vector3* velocities) const {
+    PROFILE_SCOPE("ephemeris evaluate");
+    if (!header || first > header->count || count > header->count - first) {
+        std::cout << "Ephemeris evaluate of bodies " << first << " + " << count << " is out of range of the " << size() << " tabulated" << std::endl;
+        return;
+    }
+    //Which interval, and where in it on [-1, 1]; the series and its slope are the same for every body
+    double length = header->intervalLength;
+    double offset = std::min(std::max(time - header->startTime, 0.0), header->intervalCount * length);
+    unsigned int interval = std::min((unsigned int)(offset / length), header->intervalCount - 1);
+    double x = 2.0 * (offset - interval * length) / length - 1.0;
+    unsigned int terms = header->degree + 1;
+    std::vector<double> values(terms), slopes(terms);
+    chebyshev(x, header->degree, values.data(), slopes.data());
+    std::vector<float> weights(terms), rates(terms);
+    for (unsigned int k = 0; k < terms; ++k) {
+        weights[k] = (float)values[k];
+        //dx/dt = 2 / length
+        rates[k] = (float)(slopes[k] * 2.0 / length);
+    }
+
+    unsigned int total = header->count;
+    const float* block = coefficients + (size_t)interval * terms * 3 * total;
+    JobSystem::parallelFor(count, EVALUATE_CHUNK, [&](unsigned int begin, unsigned int end) {
+        //Summed a coefficient at a time across up to a chunk of bodies, so the inner loops run straight
+        //down the block. One thread gets the whole range in one call, hence the loop
+        float position[3][EVALUATE_CHUNK], velocity[3][EVALUATE_CHUNK];
+        for (unsigned int start = begin; start < end; start += EVALUATE_CHUNK) {
+            unsigned int span = std::min(end - start, (unsigned int)EVALUATE_CHUNK);
+            for (unsigned int axis = 0; axis < 3; ++axis) {
+                std::fill(position[axis], position[axis] + span, 0.0f);
+                std::fill(velocity[axis], velocity[axis] + span, 0.0f);
+            }
+            for (unsigned int k = 0; k < terms; ++k) {
+                for (unsigned int axis = 0; axis < 3; ++axis) {
+                    const float* c = block + ((size_t)k * 3 + axis) * total + first + start;
+                    float weight = weights[k], rate = rates[k];
+                    float* p = position[axis];
+                    for (unsigned int i = 0; i < span; ++i) {
+                        p[i] += c[i] * weight;
+                    }
+                    if (velocities) {
+                        float* v = velocity[axis];
+                        for (unsigned int i = 0; i < span; ++i) {
+                            v[i] += c[i] * rate;
+                        }
+                    }
+                }
+            }
+            for (unsigned int i = 0; i < span; ++i) {
+                positions[start + i] = Vector3{ position[0][i], position[1][i], position[2][i] };
+            }
+            if (velocities) {
+                for (unsigned int i = 0; i < span; ++i) {
+                    velocities[start + i] = Vector3{ velocity[0][i], velocity[1][i], velocity[2][i] };
+                }
+            }
+        }
+    });
+}
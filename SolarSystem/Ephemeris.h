@@ -0,0 +1,71 @@
+#ifndef EPHEMERIS_H
+#define EPHEMERIS_H
+
+#include <cstdint>
+#include <string>
+#include "BodyTypes.h"
+#include "MappedFile.h"
+#include "Simulation.h"
+
+//A precomputed table of every body's trajectory, so positions and velocities at any time in its span
+//come from a few multiply-adds instead of stepping the simulation there.
+//
+//The span is cut into fixed intervals and each body's x, y and z over an interval are stored as the
+//coefficients of a Chebyshev series. generate() steps a Simulation through the span in whichever
+//mode it is in (kinematic or N-body), samples every body at evenly spaced fixed steps and fits the
+//series to the samples by least squares; one fitting matrix serves every body and interval.
+//
+//The file is an EphemerisHeader followed by one block per interval, each (degree + 1) * 3 * count
+//floats ordered [coefficient][axis][body], so one lookup reads one contiguous block and the
+//evaluator runs across bodies. The file is memory-mapped; only the blocks a query touches are read.
+class Ephemeris {
+public:
+	struct EphemerisHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t count;
+		uint32_t degree;
+		uint32_t intervalCount;
+		double startTime;
+		//Seconds per interval
+		double intervalLength;
+		//Byte offset of the first interval's block
+		uint64_t dataOffset;
+		//Largest distance between the fit and a sample, over every body and interval
+		float maxFitError;
+	};
+	static const uint32_t VERSION = 1;
+	//Defaults: an interval is 32 fixed steps (1/7.5s, about a quarter of the moon's orbit),
+	//sampled every 2 steps and fitted with a degree 10 series
+	static const unsigned int DEFAULT_INTERVAL_STEPS = 32;
+	static const unsigned int DEFAULT_SAMPLE_STEPS = 2;
+	static const unsigned int DEFAULT_DEGREE = 10;
+	//Bodies per job
+	static const unsigned int EVALUATE_CHUNK = 4096;
+	static const unsigned int CAPTURE_CHUNK = 16384;
+private:
+	MappedFile file;
+	const EphemerisHeader* header;
+	const float* coefficients;
+public:
+	Ephemeris();
+	//Tabulates intervalCount intervals from the simulation's current time, stepping it to the end.
+	//intervalSteps must be a multiple of sampleSteps, with at least degree + 1 samples per interval
+	static bool generate(Simulation& simulation, const std::string& path, unsigned int intervalCount, unsigned int intervalSteps = DEFAULT_INTERVAL_STEPS,
+		unsigned int sampleSteps = DEFAULT_SAMPLE_STEPS, unsigned int degree = DEFAULT_DEGREE);
+	bool open(const std::string& path);
+	void close();
+	bool isOpen() const { return header != nullptr; }
+	unsigned int size() const { return header ? header->count : 0; }
+	double getStartTime() const { return header ? header->startTime : 0.0; }
+	double getEndTime() const { return header ? header->startTime + header->intervalCount * header->intervalLength : 0.0; }
+	float getMaxFitError() const { return header ? header->maxFitError : 0.0f; }
+	//Positions and, unless null, velocities of bodies first .. first + count - 1 at time, which is
+	//clamped to the span. Both arrays hold count values. Nothing is written if no ephemeris is open
+	//or the range runs past its bodies
+	void evaluate(double time, unsigned int first, unsigned int count, Vector3* positions, Vector3* velocities = nullptr) const;
+	//Every body at once, e.g. for scrubbing a replay
+	void evaluate(double time, Vector3* positions, Vector3* velocities = nullptr) const { evaluate(time, 0, size(), positions, velocities); }
+};
+
+#endif
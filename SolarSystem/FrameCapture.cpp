@@ -0,0 +1,139 @@
+#include<glad.h>
+#include<GLFW/glfw3.h>
+#include <cstring>
+#include <iostream>
+
+#include "FrameCapture.h"
+
+FrameCapture::~FrameCapture() {
+    //The GL objects need the context, so finish() has to have been called while it was current
+    encoder.close();
+}
+
+bool FrameCapture::create(unsigned int width, unsigned int height, const std::string& output) {
+    this->width = width;
+    this->height = height;
+
+    glGenFramebuffers(1, &FBO);
+    glGenRenderbuffers(1, &colorRBO);
+    glGenRenderbuffers(1, &depthRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete) {
+        std::cout << "Offscreen framebuffer " << width << "x" << height << " is incomplete" << std::endl;
+        finish();
+        return false;
+    }
+
+    ring.resize(RING_SIZE);
+    for (Slot& slot : ring) {
+        glGenBuffers(1, &slot.PBO);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 4, NULL, GL_STREAM_READ);
+        slot.fence = nullptr;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (!encoder.open(output, width, height)) {
+        finish();
+        return false;
+    }
+    return true;
+}
+
+void FrameCapture::bind() {
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glViewport(0, 0, width, height);
+}
+
+bool FrameCapture::collect(Slot& slot, bool wait) {
+    GLsync fence = (GLsync)slot.fence;
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        if (!wait) {
+            return false;
+        }
+        ++stalls;
+        //Flushes first in case the fence has not even reached the GPU yet
+        status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+    }
+    glDeleteSync(fence);
+    slot.fence = nullptr;
+    if (status == GL_WAIT_FAILED || status == GL_TIMEOUT_EXPIRED) {
+        std::cout << "Lost captured frame " << slot.frame << std::endl;
+        return true;
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+    const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)width * height * 4, GL_MAP_READ_BIT);
+    if (pixels != NULL) {
+        std::vector<unsigned char> buffer = encoder.acquireBuffer();
+        std::memcpy(buffer.data(), pixels, buffer.size());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        encoder.submit(std::move(buffer), slot.frame);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return true;
+}
+
+void FrameCapture::capture() {
+    //next is the oldest slot and is about to be reused, so it has to be collected whatever happens;
+    //the newer ones go to the encoder too if they happen to be finished. Oldest first keeps frames in order.
+    Slot& slot = ring[next];
+    if (slot.fence != nullptr) {
+        collect(slot, true);
+    }
+    for (unsigned int offset = 1; offset < RING_SIZE; ++offset) {
+        Slot& newer = ring[(next + offset) % RING_SIZE];
+        if (newer.fence == nullptr || !collect(newer, false)) {
+            break;
+        }
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+    //With a pack buffer bound this only queues the copy and returns straight away
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frame = frameCount++;
+    next = (next + 1) % RING_SIZE;
+}
+
+void FrameCapture::blitToScreen(int screenWidth, int screenHeight) {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, screenWidth, screenHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void FrameCapture::finish() {
+    //Oldest first: next is the slot written longest ago
+    for (unsigned int offset = 0; offset < ring.size(); ++offset) {
+        Slot& slot = ring[(next + offset) % ring.size()];
+        if (slot.fence != nullptr) {
+            collect(slot, true);
+        }
+        glDeleteBuffers(1, &slot.PBO);
+    }
+    ring.clear();
+    encoder.close();
+    if (FBO != 0) {
+        glDeleteFramebuffers(1, &FBO);
+        glDeleteRenderbuffers(1, &colorRBO);
+        glDeleteRenderbuffers(1, &depthRBO);
+        FBO = 0;
+    }
+    if (frameCount > 0) {
+        std::cout << "Captured " << frameCount << " frames, " << stalls << " readback stalls" << std::endl;
+    }
+}
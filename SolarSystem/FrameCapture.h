@@ -0,0 +1,50 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <vector>
+#include "FrameEncoder.h"
+
+//Renders into an offscreen framebuffer of any size and streams every frame to a FrameEncoder.
+//
+//Readback goes through a ring of pixel buffer objects: each frame's glReadPixels only queues a
+//copy into the next PBO (and a fence), and a PBO is mapped RING_SIZE - 1 frames later once its
+//fence has signalled, so the CPU never waits for the GPU to finish the frame it just submitted.
+//Only when the whole ring is still in flight does capture() wait, and that is counted as a stall.
+class FrameCapture {
+private:
+	struct Slot {
+		unsigned int PBO;
+		//GLsync, kept opaque so this header does not need the GL headers
+		void* fence;
+		unsigned long long frame;
+	};
+	unsigned int width = 0, height = 0;
+	unsigned int FBO = 0, colorRBO = 0, depthRBO = 0;
+	std::vector<Slot> ring;
+	unsigned int next = 0;
+	unsigned long long frameCount = 0;
+	unsigned long long stalls = 0;
+	FrameEncoder encoder;
+	//Maps a finished slot and hands its pixels to the encoder; wait decides whether to block on the fence
+	bool collect(Slot& slot, bool wait);
+public:
+	static const unsigned int RING_SIZE = 3;
+	~FrameCapture();
+	//Needs a current OpenGL context. output is passed to FrameEncoder::open
+	bool create(unsigned int width, unsigned int height, const std::string& output);
+	bool isActive() const { return FBO != 0; }
+	//Makes the offscreen framebuffer the render target
+	void bind();
+	//Queues the readback of what was just drawn, collecting any earlier frames that are ready
+	void capture();
+	//Copies the last frame to the default framebuffer, scaled to fit, for an on-screen preview
+	void blitToScreen(int screenWidth, int screenHeight);
+	unsigned int getWidth() const { return width; }
+	unsigned int getHeight() const { return height; }
+	unsigned long long getFrameCount() const { return frameCount; }
+	unsigned long long getStalls() const { return stalls; }
+	//Reads back every frame still in flight, waits for the encoder and frees the GL objects
+	void finish();
+};
+
+#endif
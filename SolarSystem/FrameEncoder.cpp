@@ -0,0 +1,145 @@
+#include <iostream>
+#include <filesystem>
+#include <utility>
+#include "FrameEncoder.h"
+
+FrameEncoder::FrameEncoder() {
+    format = IMAGE_SEQUENCE;
+    width = 0;
+    height = 0;
+    rawFile = nullptr;
+    closing = false;
+    framesWritten = 0;
+}
+
+FrameEncoder::~FrameEncoder() {
+    close();
+}
+
+static bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool FrameEncoder::open(const std::string& output, unsigned int width, unsigned int height) {
+    close();
+    this->output = output;
+    this->width = width;
+    this->height = height;
+    format = endsWith(output, ".rgb") || endsWith(output, ".raw") ? RAW_VIDEO : IMAGE_SEQUENCE;
+    if (format == RAW_VIDEO) {
+        rawFile = std::fopen(output.c_str(), "wb");
+        if (rawFile == nullptr) {
+            std::cout << "Failed to open capture output " << output << std::endl;
+            return false;
+        }
+    }
+    else {
+        std::error_code error;
+        std::filesystem::create_directories(output, error);
+        if (error) {
+            std::cout << "Failed to create capture directory " << output << ": " << error.message() << std::endl;
+            return false;
+        }
+    }
+    closing = false;
+    framesWritten = 0;
+    thread = std::thread(&FrameEncoder::encoderLoop, this);
+    std::cout << "Capturing " << width << "x" << height << (format == RAW_VIDEO ? " rgb24 frames to " : " PPM frames into ") << output << std::endl;
+    return true;
+}
+
+std::vector<unsigned char> FrameEncoder::acquireBuffer() {
+    std::vector<unsigned char> buffer;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!freeBuffers.empty()) {
+            buffer = std::move(freeBuffers.back());
+            freeBuffers.pop_back();
+        }
+    }
+    buffer.resize((size_t)width * height * 4);
+    return buffer;
+}
+
+void FrameEncoder::submit(std::vector<unsigned char>&& rgba, unsigned long long index) {
+    std::unique_lock<std::mutex> lock(mutex);
+    //Back-pressure: the render loop slows to the disk's pace rather than queueing without limit
+    changed.wait(lock, [this]() { return queue.size() < MAX_QUEUED; });
+    queue.push_back(Frame{ std::move(rgba), index });
+    changed.notify_all();
+}
+
+void FrameEncoder::encoderLoop() {
+    while (true) {
+        Frame frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this]() { return !queue.empty() || closing; });
+            if (queue.empty()) {
+                return;
+            }
+            frame = std::move(queue.front());
+            queue.pop_front();
+            changed.notify_all();
+        }
+
+        bool written = writeFrame(frame);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (written) {
+            ++framesWritten;
+        }
+        freeBuffers.push_back(std::move(frame.rgba));
+    }
+}
+
+bool FrameEncoder::writeFrame(const Frame& frame) {
+    //glReadPixels rows run bottom to top; images run top to bottom
+    rgb.resize((size_t)width * height * 3);
+    for (unsigned int row = 0; row < height; ++row) {
+        const unsigned char* in = frame.rgba.data() + (size_t)(height - 1 - row) * width * 4;
+        unsigned char* out = rgb.data() + (size_t)row * width * 3;
+        for (unsigned int x = 0; x < width; ++x) {
+            out[x * 3] = in[x * 4];
+            out[x * 3 + 1] = in[x * 4 + 1];
+            out[x * 3 + 2] = in[x * 4 + 2];
+        }
+    }
+
+    if (format == RAW_VIDEO) {
+        return std::fwrite(rgb.data(), 1, rgb.size(), rawFile) == rgb.size();
+    }
+    char name[32];
+    std::snprintf(name, sizeof(name), "/frame_%06llu.ppm", frame.index);
+    std::FILE* file = std::fopen((output + name).c_str(), "wb");
+    if (file == nullptr) {
+        std::cout << "Failed to write " << output << name << std::endl;
+        return false;
+    }
+    std::fprintf(file, "P6\n%u %u\n255\n", width, height);
+    bool ok = std::fwrite(rgb.data(), 1, rgb.size(), file) == rgb.size();
+    std::fclose(file);
+    return ok;
+}
+
+void FrameEncoder::close() {
+    if (!thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    changed.notify_all();
+    thread.join();
+    if (rawFile != nullptr) {
+        std::fclose(rawFile);
+        rawFile = nullptr;
+    }
+    std::cout << "Wrote " << framesWritten << " captured frames to " << output << std::endl;
+}
+
+unsigned long long FrameEncoder::getFramesWritten() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return framesWritten;
+}
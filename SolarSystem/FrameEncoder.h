@@ -0,0 +1,62 @@
+#ifndef FRAMEENCODER_H
+#define FRAMEENCODER_H
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//Writes captured frames to disk on its own thread so the render loop never waits on file I/O.
+//
+//Frames arrive as bottom-up RGBA (straight from glReadPixels); the encoder flips and converts
+//them to top-down RGB. Output ending in .rgb or .raw is one headerless rgb24 stream
+//(ffmpeg -f rawvideo -pix_fmt rgb24 -s WxH -i FILE), anything else is a directory that gets
+//a frame_000000.ppm image sequence. Has no OpenGL dependency. Pixel buffers are recycled,
+//and submit() blocks once MAX_QUEUED frames are waiting so a slow disk cannot use up memory.
+class FrameEncoder {
+public:
+	enum Format {
+		IMAGE_SEQUENCE,
+		RAW_VIDEO
+	};
+	static const unsigned int MAX_QUEUED = 8;
+private:
+	struct Frame {
+		std::vector<unsigned char> rgba;
+		unsigned long long index;
+	};
+	Format format;
+	std::string output;
+	unsigned int width, height;
+	std::FILE* rawFile;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque<Frame> queue;
+	std::vector<std::vector<unsigned char>> freeBuffers;
+	bool closing;
+	unsigned long long framesWritten;
+	//Scratch on the encoder thread for one converted frame
+	std::vector<unsigned char> rgb;
+	void encoderLoop();
+	bool writeFrame(const Frame& frame);
+public:
+	FrameEncoder();
+	~FrameEncoder();
+	FrameEncoder(const FrameEncoder&) = delete;
+	FrameEncoder& operator=(const FrameEncoder&) = delete;
+	bool open(const std::string& output, unsigned int width, unsigned int height);
+	//An empty width * height * 4 buffer to fill, reused from earlier frames where possible
+	std::vector<unsigned char> acquireBuffer();
+	//Hands a filled buffer to the encoder thread
+	void submit(std::vector<unsigned char>&& rgba, unsigned long long index);
+	//Writes everything still queued and stops the thread
+	void close();
+	bool isOpen() const { return thread.joinable(); }
+	unsigned long long getFramesWritten();
+};
+
+#endif
@@ -0,0 +1,57 @@
+#include<glad.h>
+#include<GLFW/glfw3.h>
+#include <cstddef>
+#include <cstring>
+
+#include "FrameUniforms.h"
+#include "ShaderProgram.h"
+
+FrameUniforms::FrameUniforms() {
+    block = FrameBlock();
+    cameraDirty = true;
+    lightDirty = true;
+
+    glGenBuffers(1, &UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameBlock), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, ShaderProgram::FRAME_BLOCK_BINDING, UBO);
+}
+
+void FrameUniforms::setCamera(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos) {
+    glm::vec4 viewPos4(viewPos, 1.0f);
+    //The camera only moves while a key is held, so most frames change nothing
+    if (std::memcmp(&block.view, &view, sizeof(view)) == 0 &&
+        std::memcmp(&block.projection, &projection, sizeof(projection)) == 0 &&
+        std::memcmp(&block.viewPos, &viewPos4, sizeof(viewPos4)) == 0) {
+        return;
+    }
+    block.view = view;
+    block.projection = projection;
+    block.viewPos = viewPos4;
+    cameraDirty = true;
+}
+
+void FrameUniforms::setLight(const glm::vec3& lightPos, const glm::vec3& lightColor) {
+    block.lightPos = glm::vec4(lightPos, 1.0f);
+    block.lightColor = glm::vec4(lightColor, 1.0f);
+    lightDirty = true;
+}
+
+void FrameUniforms::upload() {
+    if (!cameraDirty && !lightDirty) {
+        return;
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    if (cameraDirty) {
+        glBufferSubData(GL_UNIFORM_BUFFER, offsetof(FrameBlock, view), offsetof(FrameBlock, lightPos), &block.view);
+        cameraDirty = false;
+    }
+    if (lightDirty) {
+        glBufferSubData(GL_UNIFORM_BUFFER, offsetof(FrameBlock, lightPos), sizeof(FrameBlock) - offsetof(FrameBlock, lightPos), &block.lightPos);
+        lightDirty = false;
+    }
+}
+
+void FrameUniforms::clear() {
+    glDeleteBuffers(1, &UBO);
+}
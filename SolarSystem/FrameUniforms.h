@@ -0,0 +1,29 @@
+#ifndef FRAMEUNIFORMS_H
+#define FRAMEUNIFORMS_H
+
+#include <glm.hpp>
+
+//Per-frame camera data and the (constant) light, shared by every program through one uniform buffer.
+//Layout must match the std140 FrameData block in the shaders.
+class FrameUniforms {
+private:
+	struct FrameBlock {
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::vec4 viewPos;
+		glm::vec4 lightPos;
+		glm::vec4 lightColor;
+	};
+	unsigned int UBO;
+	FrameBlock block;
+	bool cameraDirty, lightDirty;
+public:
+	FrameUniforms();
+	void setCamera(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos);
+	void setLight(const glm::vec3& lightPos, const glm::vec3& lightColor);
+	//Sends only the parts of the block that changed since the last upload
+	void upload();
+	void clear();
+};
+
+#endif
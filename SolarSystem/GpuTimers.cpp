@@ -0,0 +1,70 @@
+#include<glad.h>
+#include<GLFW/glfw3.h>
+
+#include "GpuTimers.h"
+#include "Profiler.h"
+
+void GpuTimers::beginFrame() {
+    for (Pass& pass : passes) {
+        for (unsigned int slot = 0; slot < LATENCY; ++slot) {
+            if (!pass.pending[slot]) {
+                continue;
+            }
+            int available = 0;
+            glGetQueryObjectiv(pass.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint64 elapsed = 0;
+                glGetQueryObjectui64v(pass.queries[slot], GL_QUERY_RESULT, &elapsed);
+                Profiler::recordGpu(pass.name, pass.issued[slot], (int64_t)elapsed);
+                pass.pending[slot] = false;
+            }
+        }
+    }
+    ++frame;
+}
+
+void GpuTimers::begin(const char* name) {
+    if (!Profiler::isEnabled()) {
+        return;
+    }
+    unsigned int index = 0;
+    while (index < passes.size() && passes[index].name != name) {
+        ++index;
+    }
+    if (index == passes.size()) {
+        Pass pass;
+        pass.name = name;
+        glGenQueries(LATENCY, pass.queries);
+        for (unsigned int slot = 0; slot < LATENCY; ++slot) {
+            pass.pending[slot] = false;
+        }
+        passes.push_back(pass);
+    }
+
+    Pass& pass = passes[index];
+    unsigned int slot = frame % LATENCY;
+    if (pass.pending[slot]) {
+        //The GPU is more than LATENCY frames behind; skip rather than wait for it
+        return;
+    }
+    pass.issued[slot] = Profiler::now();
+    glBeginQuery(GL_TIME_ELAPSED, pass.queries[slot]);
+    active = index;
+}
+
+void GpuTimers::end() {
+    if (active < 0) {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    passes[active].pending[frame % LATENCY] = true;
+    active = -1;
+}
+
+void GpuTimers::clear() {
+    for (Pass& pass : passes) {
+        glDeleteQueries(LATENCY, pass.queries);
+    }
+    passes.clear();
+    active = -1;
+}
@@ -0,0 +1,36 @@
+#ifndef GPUTIMERS_H
+#define GPUTIMERS_H
+
+#include <cstdint>
+#include <vector>
+
+//GL_TIME_ELAPSED queries around each render pass, reported to the Profiler's GPU track.
+//
+//Each pass has a small ring of query objects and results are read LATENCY frames later,
+//once the GPU has caught up, so reading them never stalls the pipeline. If a query is
+//still not ready when its slot comes round again, that frame's pass simply goes untimed.
+//Passes cannot nest (only one GL_TIME_ELAPSED query may be active at a time).
+class GpuTimers {
+public:
+	static const unsigned int LATENCY = 4;
+private:
+	struct Pass {
+		const char* name;
+		unsigned int queries[LATENCY];
+		//When the CPU issued the pass, used to place the GPU event on the timeline
+		int64_t issued[LATENCY];
+		bool pending[LATENCY];
+	};
+	std::vector<Pass> passes;
+	unsigned int frame = 0;
+	int active = -1;
+public:
+	//Reads back every finished query and moves on to the next slot; call once at the start of a frame
+	void beginFrame();
+	//name must be a string literal; the same pointer identifies the pass every frame
+	void begin(const char* name);
+	void end();
+	void clear();
+};
+
+#endif
@@ -0,0 +1,171 @@
+#include <cmath>
+#include <algorithm>
+#include "GravitySystem.h"
+#include "JobSystem.h"
+
+GravitySystem::GravitySystem(double gravitationalConstant, double fixedStep, double softening) {
+    this->gravitationalConstant = gravitationalConstant;
+    this->fixedStep = fixedStep;
+    this->softening = softening;
+    accelerationsValid = false;
+    solver = DIRECT_SUM;
+}
+
+void GravitySystem::clear() {
+    posX.clear(); posY.clear(); posZ.clear();
+    velX.clear(); velY.clear(); velZ.clear();
+    accX.clear(); accY.clear(); accZ.clear();
+    mass.clear();
+    accelerationsValid = false;
+}
+
+void GravitySystem::reserve(unsigned int count) {
+    posX.reserve(count); posY.reserve(count); posZ.reserve(count);
+    velX.reserve(count); velY.reserve(count); velZ.reserve(count);
+    accX.reserve(count); accY.reserve(count); accZ.reserve(count);
+    mass.reserve(count);
+}
+
+unsigned int GravitySystem::addBody(double massKg, Vector3 pos, Vector3 vel) {
+    posX.push_back(pos.x); posY.push_back(pos.y); posZ.push_back(pos.z);
+    velX.push_back(vel.x); velY.push_back(vel.y); velZ.push_back(vel.z);
+    accX.push_back(0.0); accY.push_back(0.0); accZ.push_back(0.0);
+    mass.push_back(massKg);
+    accelerationsValid = false;
+    return mass.size() - 1;
+}
+
+void GravitySystem::setOrbitVelocity(unsigned int body, unsigned int parent, Vector3 direction, double semiMajorAxis) {
+    double dx = posX[body] - posX[parent];
+    double dy = posY[body] - posY[parent];
+    double dz = posZ[body] - posZ[parent];
+    double r = std::sqrt(dx * dx + dy * dy + dz * dz);
+    //v^2 = G(M + m)(2/r - 1/a)
+    double speed = 0.0;
+    if (r > 0.0 && semiMajorAxis > 0.0) {
+        speed = std::sqrt(std::max(0.0, gravitationalConstant * (mass[parent] + mass[body]) * (2.0 / r - 1.0 / semiMajorAxis)));
+    }
+
+    double length = std::sqrt((double)direction.x * direction.x + (double)direction.y * direction.y + (double)direction.z * direction.z);
+    double unitX, unitY, unitZ;
+    if (length > 0.0) {
+        unitX = direction.x / length;
+        unitY = direction.y / length;
+        unitZ = direction.z / length;
+    }
+    else {
+        double flat = std::sqrt(dx * dx + dz * dz);
+        unitX = flat > 0.0 ? -dz / flat : 0.0;
+        unitY = 0.0;
+        unitZ = flat > 0.0 ? dx / flat : 0.0;
+    }
+
+    velX[body] = velX[parent] + speed * unitX;
+    velY[body] = velY[parent] + speed * unitY;
+    velZ[body] = velZ[parent] + speed * unitZ;
+    accelerationsValid = false;
+}
+
+void GravitySystem::setSolver(ForceSolver solver, double theta) {
+    this->solver = solver;
+    tree.setTheta(theta);
+    accelerationsValid = false;
+}
+
+//Accelerations for rows [begin, end), sweeping the other bodies one cache-sized tile at a time
+void GravitySystem::computeRows(unsigned int begin, unsigned int end) {
+    unsigned int count = size();
+    double eps2 = softening * softening;
+
+    for (unsigned int i = begin; i < end; ++i) {
+        accX[i] = 0.0;
+        accY[i] = 0.0;
+        accZ[i] = 0.0;
+    }
+
+    for (unsigned int tile = 0; tile < count; tile += BLOCK_SIZE) {
+        unsigned int tileEnd = std::min(tile + BLOCK_SIZE, count);
+        for (unsigned int i = begin; i < end; ++i) {
+            double xi = posX[i], yi = posY[i], zi = posZ[i];
+            double ax = 0.0, ay = 0.0, az = 0.0;
+            //No i != j test: with softening, a body's pull on itself is exactly zero
+            for (unsigned int j = tile; j < tileEnd; ++j) {
+                double dx = posX[j] - xi;
+                double dy = posY[j] - yi;
+                double dz = posZ[j] - zi;
+                double dist2 = dx * dx + dy * dy + dz * dz + eps2;
+                double invDist = 1.0 / std::sqrt(dist2);
+                double strength = mass[j] * invDist * invDist * invDist;
+                ax += dx * strength;
+                ay += dy * strength;
+                az += dz * strength;
+            }
+            accX[i] += ax;
+            accY[i] += ay;
+            accZ[i] += az;
+        }
+    }
+
+    for (unsigned int i = begin; i < end; ++i) {
+        accX[i] *= gravitationalConstant;
+        accY[i] *= gravitationalConstant;
+        accZ[i] *= gravitationalConstant;
+    }
+}
+
+void GravitySystem::computeAccelerations() {
+    unsigned int count = size();
+    if (solver == BARNES_HUT) {
+        tree.build(posX.data(), posY.data(), posZ.data(), mass.data(), count);
+        tree.computeAccelerations(accX.data(), accY.data(), accZ.data(), gravitationalConstant, softening);
+        return;
+    }
+
+    //Each job owns one row block, so no two jobs write the same body
+    JobSystem::parallelFor(count, BLOCK_SIZE, [this](unsigned int begin, unsigned int end) {
+        computeRows(begin, end);
+    });
+}
+
+void GravitySystem::step() {
+    unsigned int count = size();
+    double halfStep = 0.5 * fixedStep;
+    if (!accelerationsValid) {
+        computeAccelerations();
+        accelerationsValid = true;
+    }
+
+    //Kick, drift
+    for (unsigned int i = 0; i < count; ++i) {
+        velX[i] += accX[i] * halfStep;
+        velY[i] += accY[i] * halfStep;
+        velZ[i] += accZ[i] * halfStep;
+        posX[i] += velX[i] * fixedStep;
+        posY[i] += velY[i] * fixedStep;
+        posZ[i] += velZ[i] * fixedStep;
+    }
+
+    computeAccelerations();
+
+    //Kick
+    for (unsigned int i = 0; i < count; ++i) {
+        velX[i] += accX[i] * halfStep;
+        velY[i] += accY[i] * halfStep;
+        velZ[i] += accZ[i] * halfStep;
+    }
+}
+
+double GravitySystem::totalEnergy() const {
+    unsigned int count = size();
+    double kinetic = 0.0, potential = 0.0;
+    for (unsigned int i = 0; i < count; ++i) {
+        kinetic += 0.5 * mass[i] * (velX[i] * velX[i] + velY[i] * velY[i] + velZ[i] * velZ[i]);
+        for (unsigned int j = i + 1; j < count; ++j) {
+            double dx = posX[j] - posX[i];
+            double dy = posY[j] - posY[i];
+            double dz = posZ[j] - posZ[i];
+            potential -= gravitationalConstant * mass[i] * mass[j] / std::sqrt(dx * dx + dy * dy + dz * dz + softening * softening);
+        }
+    }
+    return kinetic + potential;
+}
@@ -0,0 +1,59 @@
+#ifndef GRAVITYSYSTEM_H
+#define GRAVITYSYSTEM_H
+
+#include <vector>
+#include "BodyTypes.h"
+#include "BarnesHut.h"
+
+//Newtonian N-body gravity for the optional physics mode.
+//State is kept in double precision SoA arrays and integrated with kick-drift-kick leapfrog
+//(velocity Verlet), which is symplectic so orbits do not spiral in or out over long runs.
+//It always steps by a fixed timestep; Simulation decides how many steps a frame gets.
+class GravitySystem {
+public:
+	enum ForceSolver {
+		DIRECT_SUM,	//Exact O(N^2)
+		BARNES_HUT	//Approximate O(N log N), accuracy set by the opening angle
+	};
+private:
+	std::vector<double> posX, posY, posZ;
+	std::vector<double> velX, velY, velZ;
+	std::vector<double> accX, accY, accZ;
+	std::vector<double> mass;
+	double gravitationalConstant;
+	//Plummer softening length, stops close encounters blowing up
+	double softening;
+	double fixedStep;
+	bool accelerationsValid;
+	ForceSolver solver;
+	BarnesHut tree;
+	void computeAccelerations();
+	void computeRows(unsigned int begin, unsigned int end);
+	friend class Snapshot;
+public:
+	//Rows of the force matrix handed to each job, and the column tile size
+	//(a tile of 256 bodies is 8KB of positions and masses, so it stays in L1 while a row block sweeps it)
+	static const unsigned int BLOCK_SIZE = 256;
+	GravitySystem(double gravitationalConstant, double fixedStep, double softening = 0.01);
+	void clear();
+	void reserve(unsigned int count);
+	unsigned int addBody(double massKg, Vector3 pos, Vector3 vel);
+	//Gives a body the velocity of a Keplerian orbit around another with the given semi-major axis
+	//(vis-viva speed, so a equal to the current distance is a circle). Only the direction of `direction`
+	//is used; a zero direction means the prograde tangent in the xz plane.
+	//The parent's own velocity must already be set.
+	void setOrbitVelocity(unsigned int body, unsigned int parent, Vector3 direction, double semiMajorAxis);
+	//One leapfrog step of fixedStep seconds
+	void step();
+	//theta is only used by BARNES_HUT
+	void setSolver(ForceSolver solver, double theta = 0.5);
+	ForceSolver getSolver() const { return solver; }
+	double getFixedStep() const { return fixedStep; }
+	unsigned int size() const { return mass.size(); }
+	Vector3 getPos(unsigned int i) const { return { (float)posX[i], (float)posY[i], (float)posZ[i] }; }
+	Vector3 getVel(unsigned int i) const { return { (float)velX[i], (float)velY[i], (float)velZ[i] }; }
+	//Kinetic plus potential energy, for checking the integrator conserves it
+	double totalEnergy() const;
+};
+
+#endif
@@ -0,0 +1,469 @@
+//Entry point for the headless simulator: no window, no vsync and no OpenGL context.
+//Built from the simulation core only, e.g. on Linux:
+//  g++ -O2 -std=c++17 -pthread HeadlessMain.cpp Simulation.cpp BodyStore.cpp OrbitKernel.cpp GravitySystem.cpp BarnesHut.cpp Catalog.cpp MappedFile.cpp JobSystem.cpp
+//      Culler.cpp LodSelector.cpp MeshBuilder.cpp Profiler.cpp
+//      Snapshot.cpp TrajectoryWriter.cpp CollisionDetector.cpp Ephemeris.cpp -o solarsystem-headless
+//
+//Usage: solarsystem-headless [--catalog FILE] [--write-catalog FILE] [--steps N] [--dt SECONDS] [--warp W] [--start T] [--bodies N]
+//                            [--mode kinematic|gravity] [--solver direct|barnes-hut] [--theta T] [--threads N] [--check] [--mesh-report]
+//                            [--trace FILE] [--restore SNAPSHOT] [--checkpoint SNAPSHOT]
+//                            [--trajectory FILE] [--record-every STEPS] [--compress]
+//                            [--collisions APPROACH_DISTANCE] [--events FILE]
+//                            [--write-ephemeris FILE] [--intervals N] [--ephemeris FILE]
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <chrono>
+#include <algorithm>
+
+#include "Simulation.h"
+#include "OrbitKernel.h"
+#include "Catalog.h"
+#include "JobSystem.h"
+#include "LodSelector.h"
+#include "MeshBuilder.h"
+#include "Profiler.h"
+#include "Snapshot.h"
+#include "TrajectoryWriter.h"
+#include "Ephemeris.h"
+
+static void printUsage() {
+    std::cout << "Usage: solarsystem-headless [--catalog FILE] [--write-catalog FILE] [--steps N] [--dt SECONDS] [--warp W] [--start T] [--bodies N]\n"
+              << "                            [--mode kinematic|gravity] [--solver direct|barnes-hut] [--theta T] [--threads N] [--check] [--mesh-report]\n"
+              << "                            [--trace FILE] [--restore SNAPSHOT] [--checkpoint SNAPSHOT]\n"
+              << "                            [--trajectory FILE] [--record-every STEPS] [--compress]\n"
+              << "                            [--collisions APPROACH_DISTANCE] [--events FILE]\n"
+              << "                            [--write-ephemeris FILE] [--intervals N] [--ephemeris FILE]" << std::endl;
+}
+
+//Vertex cache and memory figures for every sphere level of detail the renderer uses
+static void reportMeshes() {
+    LodSelector lod;
+    std::cout << "divisions vertices triangles acmr16(ring) acmr16 acmr32 index-bytes vertex-bytes(float) vertex-bytes(packed) build-ms" << std::endl;
+    for (unsigned int level = 0; level < lod.getLevelCount(); ++level) {
+        unsigned int divisions = lod.getDivisions(level);
+        std::vector<float> positions;
+        std::vector<uint32_t> ringOrder;
+        MeshBuilder::generateSphere(positions, ringOrder, divisions, divisions);
+
+        auto buildStart = std::chrono::steady_clock::now();
+        MeshData packed = MeshBuilder::buildSphere(divisions, divisions, PACKED_NORMALS);
+        double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count();
+        MeshData unpacked = MeshBuilder::buildSphere(divisions, divisions, FLOAT_NORMALS);
+
+        std::vector<uint32_t> built = packed.indices32;
+        if (built.empty()) {
+            built.assign(packed.indices16.begin(), packed.indices16.end());
+        }
+        std::cout << divisions << " " << packed.vertexCount << " " << built.size() / 3 << " "
+                  << MeshBuilder::computeACMR(ringOrder, 16) << " " << MeshBuilder::computeACMR(built, 16) << " " << MeshBuilder::computeACMR(built, 32) << " "
+                  << packed.indexCount() * packed.indexSize() << " " << unpacked.vertexStride << " " << packed.vertexStride << " " << buildMs << std::endl;
+    }
+}
+
+//Tabulates the scene from its current time onwards, in whichever mode it is in
+static bool writeEphemeris(Simulation& simulation, const std::string& path, unsigned int intervals) {
+    auto start = std::chrono::steady_clock::now();
+    if (!Ephemeris::generate(simulation, path, intervals)) {
+        return false;
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    Ephemeris ephemeris;
+    if (!ephemeris.open(path)) {
+        return false;
+    }
+    std::cout << "Tabulated " << ephemeris.size() << " bodies from " << ephemeris.getStartTime() << "s to " << ephemeris.getEndTime() << "s in "
+              << ms << "ms, largest fit error " << ephemeris.getMaxFitError() << std::endl;
+    return true;
+}
+
+//Evaluates every body at evenly spaced times across the ephemeris, as scrubbing a replay would.
+//Kinematic orbits can be evaluated anywhere too, so they are compared against the table: each lookup
+//has to be within the recorded fit error, plus float rounding of the series summed at the body's distance
+static bool scrubEphemeris(Simulation& simulation, const std::string& path, unsigned long long lookups) {
+    Ephemeris ephemeris;
+    if (!ephemeris.open(path)) {
+        return false;
+    }
+    if (ephemeris.size() != simulation.size()) {
+        std::cout << "Ephemeris has " << ephemeris.size() << " bodies but the scene has " << simulation.size() << std::endl;
+        return false;
+    }
+    std::vector<Vector3> positions(ephemeris.size()), velocities(ephemeris.size());
+    double evaluateMs = 0.0;
+    float worst = 0.0f;
+    bool compare = simulation.getMode() == Simulation::KINEMATIC;
+    double span = ephemeris.getEndTime() - ephemeris.getStartTime();
+    for (unsigned long long n = 0; n < lookups; ++n) {
+        //Deliberately out of order, like a scrub bar being dragged about
+        double time = ephemeris.getStartTime() + span * std::fmod(n * 0.6180339887, 1.0);
+        auto start = std::chrono::steady_clock::now();
+        ephemeris.evaluate(time, positions.data(), velocities.data());
+        evaluateMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (compare) {
+            simulation.seek(time);
+            for (unsigned int id = 0; id < simulation.size(); ++id) {
+                Vector3 exact = simulation.getPos(id);
+                float dx = positions[id].x - exact.x, dy = positions[id].y - exact.y, dz = positions[id].z - exact.z;
+                float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+                float allowed = ephemeris.getMaxFitError() + 1e-6f * (std::sqrt(exact.x * exact.x + exact.y * exact.y + exact.z * exact.z) + 1.0f);
+                if (distance > allowed) {
+                    std::cout << "Ephemeris puts body " << id << " " << distance << " from its kinematic orbit at " << time << "s, more than the "
+                              << allowed << " its fit error allows" << std::endl;
+                    return false;
+                }
+                worst = std::max(worst, distance);
+            }
+        }
+    }
+    std::cout << "Evaluated " << ephemeris.size() << " bodies at " << lookups << " times in " << ephemeris.getStartTime() << "s .. " << ephemeris.getEndTime()
+              << "s: " << evaluateMs / lookups << "ms per lookup" << std::endl;
+    if (compare) {
+        std::cout << "Largest distance from the kinematic orbits: " << worst << " (fit error " << ephemeris.getMaxFitError() << ")" << std::endl;
+    }
+    return true;
+}
+
+//Reads the trajectory file back and compares it with the frames it should hold, bit for bit
+static bool verifyTrajectory(const std::string& path, const std::vector<double>& times, const std::vector<uint64_t>& steps, const std::vector<float>& positions) {
+    TrajectoryWriter::FileHeader header;
+    std::vector<double> readTimes;
+    std::vector<uint64_t> readSteps;
+    std::vector<float> readPositions;
+    if (!TrajectoryWriter::read(path, header, readTimes, readSteps, readPositions)) {
+        return false;
+    }
+    bool same = readTimes == times && readSteps == steps && readPositions.size() == positions.size()
+        && std::memcmp(readPositions.data(), positions.data(), positions.size() * sizeof(float)) == 0;
+    std::cout << "Trajectory read back: " << readTimes.size() << " frames" << (header.compressed ? " (compressed)" : "")
+              << (same ? ", identical to the recorded frames" : ", DIFFERENT from the recorded frames") << std::endl;
+    return same;
+}
+
+//Asks for a hundred and a half fixed steps a frame with no time to take more than one, and checks that
+//every published position lies between the last two stepped states. Kinematic orbits are checked for
+//collisions meanwhile, since unchecked ones take any backlog in one go and are never cut short.
+//Moves the clock on and leaves interpolation and the budget on, so it runs last
+static bool checkInterpolation(Simulation& simulation, unsigned int frames) {
+    simulation.setInterpolation(true);
+    if (simulation.getMode() == Simulation::KINEMATIC) {
+        simulation.setCollisionDetection(true);
+    }
+    //One unbudgeted step leaves a previous state behind, which a budget cut must not leave stale
+    simulation.step(1);
+    simulation.setStepBudget(1e-9);
+    float frameTime = (float)(100.5 * simulation.getFixedStep() / simulation.getTimeWarp());
+
+    unsigned int count = simulation.size();
+    std::vector<Vector3> before(count);
+    float worst = 0.0f;
+    for (unsigned int frame = 0; frame < frames; ++frame) {
+        for (unsigned int id = 0; id < count; ++id) {
+            before[id] = simulation.getPos(id);
+        }
+        simulation.advance(frameTime);
+        if (simulation.getLastStepCount() != 1) {
+            std::cout << "Interpolation check: the step budget let " << simulation.getLastStepCount() << " steps through instead of 1" << std::endl;
+            return false;
+        }
+        simulation.publish();
+        simulation.swapPublished();
+        const std::vector<Vector3>& published = simulation.getPublished();
+        for (unsigned int id = 0; id < count; ++id) {
+            //Distance from the segment between the two states, allowing for rounding in the blend
+            Vector3 a = before[id], b = simulation.getPos(id), p = published[id];
+            float dx = b.x - a.x, dy = b.y - a.y, dz = b.z - a.z;
+            float lengthSquared = dx * dx + dy * dy + dz * dz;
+            float t = lengthSquared > 0.0f ? ((p.x - a.x) * dx + (p.y - a.y) * dy + (p.z - a.z) * dz) / lengthSquared : 0.0f;
+            t = std::min(std::max(t, 0.0f), 1.0f);
+            float ox = p.x - (a.x + dx * t), oy = p.y - (a.y + dy * t), oz = p.z - (a.z + dz * t);
+            float off = std::sqrt(ox * ox + oy * oy + oz * oz);
+            float scale = std::max(std::sqrt(a.x * a.x + a.y * a.y + a.z * a.z), std::sqrt(b.x * b.x + b.y * b.y + b.z * b.z)) + 1.0f;
+            if (off > 1e-6f * scale) {
+                std::cout << "Interpolation check: body " << id << " published at (" << p.x << ", " << p.y << ", " << p.z << "), " << off
+                          << " off the last step from (" << a.x << ", " << a.y << ", " << a.z << ") to (" << b.x << ", " << b.y << ", " << b.z << ")" << std::endl;
+                return false;
+            }
+            worst = std::max(worst, off);
+        }
+    }
+    std::cout << "Interpolated positions over " << frames << " budget-cut frames: all between the last two steps (largest offset " << worst << ")" << std::endl;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    unsigned long long steps = 1000;
+    float deltaTime = 1.0f / 60.0f;
+    double timeWarp = 1.0;
+    double startTime = 0.0;
+    unsigned int extraBodies = 0;
+    Simulation::Mode mode = Simulation::KINEMATIC;
+    GravitySystem::ForceSolver solver = GravitySystem::DIRECT_SUM;
+    double theta = 0.5;
+    unsigned int threads = 0;
+    bool check = false;
+    std::string catalogPath, writeCatalogPath, tracePath;
+    std::string restorePath, checkpointPath, trajectoryPath;
+    unsigned int recordEvery = 60;
+    bool compress = false;
+    //Negative leaves collision detection off
+    float approachDistance = -1.0f;
+    std::string eventsPath;
+    std::string writeEphemerisPath, ephemerisPath;
+    unsigned int ephemerisIntervals = 100;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--catalog" && hasValue) {
+            catalogPath = argv[++i];
+        }
+        else if (arg == "--write-catalog" && hasValue) {
+            writeCatalogPath = argv[++i];
+        }
+        else if (arg == "--steps" && hasValue) {
+            steps = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--dt" && hasValue) {
+            deltaTime = (float)std::atof(argv[++i]);
+        }
+        else if (arg == "--warp" && hasValue) {
+            timeWarp = std::atof(argv[++i]);
+        }
+        else if (arg == "--start" && hasValue) {
+            startTime = std::atof(argv[++i]);
+        }
+        else if (arg == "--bodies" && hasValue) {
+            extraBodies = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--mode" && hasValue) {
+            std::string value = argv[++i];
+            mode = value == "gravity" ? Simulation::GRAVITY : Simulation::KINEMATIC;
+        }
+        else if (arg == "--solver" && hasValue) {
+            std::string value = argv[++i];
+            solver = value == "barnes-hut" ? GravitySystem::BARNES_HUT : GravitySystem::DIRECT_SUM;
+        }
+        else if (arg == "--theta" && hasValue) {
+            theta = std::atof(argv[++i]);
+        }
+        else if (arg == "--threads" && hasValue) {
+            threads = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--check") {
+            check = true;
+        }
+        else if (arg == "--trace" && hasValue) {
+            tracePath = argv[++i];
+        }
+        else if (arg == "--restore" && hasValue) {
+            restorePath = argv[++i];
+        }
+        else if (arg == "--checkpoint" && hasValue) {
+            checkpointPath = argv[++i];
+        }
+        else if (arg == "--trajectory" && hasValue) {
+            trajectoryPath = argv[++i];
+        }
+        else if (arg == "--record-every" && hasValue) {
+            recordEvery = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--compress") {
+            compress = true;
+        }
+        else if (arg == "--collisions" && hasValue) {
+            approachDistance = (float)std::atof(argv[++i]);
+        }
+        else if (arg == "--events" && hasValue) {
+            eventsPath = argv[++i];
+        }
+        else if (arg == "--write-ephemeris" && hasValue) {
+            writeEphemerisPath = argv[++i];
+        }
+        else if (arg == "--intervals" && hasValue) {
+            ephemerisIntervals = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--ephemeris" && hasValue) {
+            ephemerisPath = argv[++i];
+        }
+        else if (arg == "--mesh-report") {
+            reportMeshes();
+            return 0;
+        }
+        else {
+            printUsage();
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    //Threads include this one; 0 leaves one per hardware thread
+    Profiler::setThreadName("main");
+    JobSystem::start(threads);
+    std::cout << "Job system: " << JobSystem::getThreadCount() << " threads" << std::endl;
+
+    Simulation simulation;
+    auto loadStart = std::chrono::steady_clock::now();
+    if (!restorePath.empty()) {
+        //Everything, mode and clock included, comes from the snapshot
+        if (!Snapshot::load(simulation, restorePath)) {
+            return 1;
+        }
+    }
+    else if (catalogPath.empty()) {
+        simulation.loadSolarSystem();
+    }
+    else if (!Catalog::load(simulation, catalogPath)) {
+        return 1;
+    }
+    std::cout << "Loaded " << simulation.size() << " bodies in "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count() << "ms" << std::endl;
+    if (extraBodies > 0 && restorePath.empty()) {
+        //Main belt between Mars and Jupiter, around the first body (the sun)
+        simulation.addAsteroidBelt(0, extraBodies, 190.0f, 340.0f, 1);
+    }
+    if (!writeCatalogPath.empty() && !Catalog::saveBinary(simulation, writeCatalogPath)) {
+        return 1;
+    }
+    if (restorePath.empty()) {
+        simulation.getGravity().setSolver(solver, theta);
+        simulation.setMode(mode);
+        simulation.setTimeWarp(timeWarp);
+    }
+    else {
+        mode = simulation.getMode();
+        std::cout << "Restored " << restorePath << " at " << simulation.getTime() << "s after " << simulation.getStepCount() << " fixed steps" << std::endl;
+    }
+    if (startTime != 0.0) {
+        auto seekStart = std::chrono::steady_clock::now();
+        simulation.seek(startTime);
+        std::cout << "Seeked to " << startTime << "s in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - seekStart).count() << "ms" << std::endl;
+    }
+
+    if (check) {
+        //Once a step ahead and once far in the future: evaluation is closed form, so both should agree equally well
+        unsigned int worstBody, farWorstBody;
+        float error = simulation.getBodies().checkBatchedAgainstScalar(simulation.getTime() + deltaTime, worstBody);
+        float farError = simulation.getBodies().checkBatchedAgainstScalar(simulation.getTime() + 1e7, farWorstBody);
+        std::cout << "Batched (" << OrbitKernel::getKernelName() << ") vs scalar Kepler solve, max relative error: " << error
+                  << " (next step), " << farError << " (1e7s ahead), tolerance " << BodyStore::BATCHED_TOLERANCE << std::endl;
+        if (error > BodyStore::BATCHED_TOLERANCE || farError > BodyStore::BATCHED_TOLERANCE) {
+            bool near = error > BodyStore::BATCHED_TOLERANCE;
+            std::cout << "Batched orbits disagree with the scalar path: body " << (near ? worstBody : farWorstBody) << " is off by "
+                      << (near ? error : farError) << " of its orbit radius " << (near ? "at the next step" : "1e7s ahead") << std::endl;
+            return 1;
+        }
+    }
+
+    if (!writeEphemerisPath.empty()) {
+        return writeEphemeris(simulation, writeEphemerisPath, ephemerisIntervals) ? 0 : 1;
+    }
+    if (!ephemerisPath.empty()) {
+        return scrubEphemeris(simulation, ephemerisPath, steps) ? 0 : 1;
+    }
+
+    std::cout << "Simulating " << simulation.size() << " bodies for " << steps << " steps of " << deltaTime << "s ("
+              << (mode == Simulation::GRAVITY ? "gravity" : "kinematic") << ")" << std::endl;
+
+    TrajectoryWriter trajectory;
+    if (!trajectoryPath.empty() && !trajectory.open(trajectoryPath, simulation.size(), recordEvery, 64, compress)) {
+        return 1;
+    }
+
+    //Events go to the file as they come, and the first few to the console
+    std::ofstream eventFile;
+    if (!eventsPath.empty()) {
+        eventFile.open(eventsPath);
+        if (!eventFile) {
+            std::cout << "Failed to write events " << eventsPath << std::endl;
+            return 1;
+        }
+        eventFile << "type,time,a,b,distance\n";
+    }
+    if (approachDistance >= 0.0f) {
+        simulation.getCollisions().setApproachDistance(approachDistance);
+        simulation.setCollisionDetection(true);
+    }
+    std::vector<CollisionEvent> events;
+    unsigned long long eventCounts[2] = { 0, 0 };
+    auto drainEvents = [&]() {
+        events.clear();
+        simulation.takeCollisionEvents(events);
+        for (const CollisionEvent& event : events) {
+            const char* type = event.type == CollisionEvent::COLLISION ? "collision" : "approach";
+            if (eventCounts[0] + eventCounts[1] < 10) {
+                std::cout << "  " << type << " " << event.a << "-" << event.b << " at " << event.time << "s, " << event.distance << " apart" << std::endl;
+            }
+            ++eventCounts[event.type];
+            if (eventFile.is_open()) {
+                eventFile << type << "," << event.time << "," << event.a << "," << event.b << "," << event.distance << "\n";
+            }
+        }
+    };
+
+    //With --check, a copy of every recorded frame to compare the file against afterwards
+    bool verifyRecording = check && trajectory.isOpen();
+    std::vector<double> recordedTimes;
+    std::vector<uint64_t> recordedSteps;
+    std::vector<float> recordedPositions;
+
+    //Each advance is one frame; the simulation turns it into fixed steps
+    unsigned long long fixedSteps = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long long step = 0; step < steps; ++step) {
+        auto frameStart = Profiler::now();
+        simulation.advance(deltaTime);
+        fixedSteps += simulation.getLastStepCount();
+        unsigned long long framesBefore = trajectory.getFramesRecorded();
+        trajectory.record(simulation);
+        if (verifyRecording && trajectory.getFramesRecorded() != framesBefore) {
+            recordedTimes.push_back(simulation.getTime());
+            recordedSteps.push_back(simulation.getStepCount());
+            for (unsigned int id = 0; id < simulation.size(); ++id) {
+                Vector3 pos = simulation.getPos(id);
+                recordedPositions.insert(recordedPositions.end(), { pos.x, pos.y, pos.z });
+            }
+        }
+        drainEvents();
+        Profiler::endFrame((Profiler::now() - frameStart) / 1e6f);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    trajectory.close();
+    if (verifyRecording && !verifyTrajectory(trajectoryPath, recordedTimes, recordedSteps, recordedPositions)) {
+        return 1;
+    }
+    if (approachDistance >= 0.0f) {
+        //Encounters still going on at the end are reported at their closest so far
+        simulation.getCollisions().flush();
+        drainEvents();
+        const CollisionDetector::Stats& collisionStats = simulation.getCollisions().getStats();
+        std::cout << "Encounters closer than " << approachDistance << ": " << eventCounts[CollisionEvent::APPROACH] << " approaches, "
+                  << eventCounts[CollisionEvent::COLLISION] << " collisions (last step: " << collisionStats.candidates << " candidate pairs, "
+                  << collisionStats.levels << " grid levels, " << collisionStats.largeBodies << " large bodies, finest cells " << collisionStats.cellSize[0] << " x " << collisionStats.cellSize[1] << " x " << collisionStats.cellSize[2] << ")" << std::endl;
+    }
+
+    //Body 3 is the earth in the built-in scene; a catalog may have fewer bodies
+    Vector3 earth = simulation.size() > 3 ? simulation.getPos(3) : Vector3{ 0, 0, 0 };
+    std::cout << "Wall time: " << seconds << "s, " << steps / seconds << " steps/s, "
+              << (double)steps * simulation.size() / seconds << " body-steps/s" << std::endl;
+    std::cout << "Fixed steps of " << simulation.getFixedStep() << "s: " << fixedSteps << " at " << simulation.getTimeWarp() << "x time warp" << std::endl;
+    std::cout << "Advance p50 " << Profiler::getFramePercentile(50.0f) << "ms, p99 " << Profiler::getFramePercentile(99.0f) << "ms (last "
+              << std::min(steps, (unsigned long long)Profiler::FRAME_WINDOW) << " frames)" << std::endl;
+    std::cout << "Simulated time: " << simulation.getTime() << "s, earth at (" << earth.x << ", " << earth.y << ", " << earth.z << ")" << std::endl;
+    if (!checkpointPath.empty()) {
+        if (!Snapshot::save(simulation, checkpointPath)) {
+            return 1;
+        }
+        std::cout << "Checkpointed " << simulation.size() << " bodies at " << simulation.getTime() << "s to " << checkpointPath << std::endl;
+    }
+    if (!tracePath.empty() && !Profiler::writeChromeTrace(tracePath)) {
+        return 1;
+    }
+    if (check && !checkInterpolation(simulation, 20)) {
+        return 1;
+    }
+    return 0;
+}
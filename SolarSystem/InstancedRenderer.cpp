@@ -0,0 +1,199 @@
+#include<glad.h>
+#include<GLFW/glfw3.h>
+#include <cstddef>
+#include <algorithm>
+
+#include "InstancedRenderer.h"
+#include "JobSystem.h"
+
+void InstancedRenderer::begin() {
+    for (auto& entry : batches) {
+        entry.second.instances.clear();
+    }
+    points.clear();
+}
+
+InstancedRenderer::Batch& InstancedRenderer::batchFor(BatchKey key) {
+    auto found = batches.find(key);
+    if (found == batches.end()) {
+        Batch batch;
+        glGenBuffers(1, &batch.instanceVBO);
+        found = batches.emplace(key, batch).first;
+    }
+    return found->second;
+}
+
+InstanceData InstancedRenderer::makeInstance(Vector3 pos, float radius, Color color) {
+    InstanceData instance;
+    instance.position[0] = pos.x;
+    instance.position[1] = pos.y;
+    instance.position[2] = pos.z;
+    instance.radius = radius;
+    instance.color[0] = color.r;
+    instance.color[1] = color.g;
+    instance.color[2] = color.b;
+    return instance;
+}
+
+void InstancedRenderer::submit(const Mesh* mesh, Vector3 pos, float radius, Color color, bool isSun) {
+    batchFor(BatchKey(mesh, isSun)).instances.push_back(makeInstance(pos, radius, color));
+}
+
+void InstancedRenderer::submit(const Sphere& sphere, bool isSun) {
+    submit(sphere.getMesh(), sphere.getPos(), sphere.getRadius(), sphere.getColor(), isSun);
+}
+
+//Three passes: each job sorts its chunk into per-mesh lists, space for every list is then
+//reserved in the shared batches (on this thread, so new buffers are created with the context current),
+//and finally the jobs copy their lists into place. The vectors are reused from frame to frame.
+void InstancedRenderer::submitDrawList(const std::vector<Sphere>& spheres, const std::vector<Vector3>& positions, const std::vector<unsigned char>& isSun, const std::vector<unsigned int>& drawList) {
+    unsigned int count = drawList.size();
+    unsigned int chunks = (count + FILL_CHUNK - 1) / FILL_CHUNK;
+    if (chunkScratch.size() < chunks) {
+        chunkScratch.resize(chunks);
+    }
+
+    JobSystem::parallelFor(chunks, 1, [&](unsigned int first, unsigned int last) {
+        for (unsigned int c = first; c < last; ++c) {
+            ChunkBatches& local = chunkScratch[c];
+            for (std::vector<InstanceData>& list : local.instances) {
+                list.clear();
+            }
+            local.keys.clear();
+            unsigned int k = 0;
+            unsigned int end = std::min((c + 1) * FILL_CHUNK, count);
+            for (unsigned int n = c * FILL_CHUNK; n < end; ++n) {
+                unsigned int i = drawList[n];
+                BatchKey key(spheres[i].getMesh(), isSun[i] != 0);
+                //Only a handful of batches, and neighbours usually share one, so a linear search is enough
+                if (k >= local.keys.size() || local.keys[k] != key) {
+                    k = 0;
+                    while (k < local.keys.size() && local.keys[k] != key) {
+                        ++k;
+                    }
+                    if (k == local.keys.size()) {
+                        local.keys.push_back(key);
+                        if (local.instances.size() < local.keys.size()) {
+                            local.instances.emplace_back();
+                        }
+                    }
+                }
+                local.instances[k].push_back(makeInstance(positions[i], spheres[i].getRadius(), spheres[i].getColor()));
+            }
+        }
+    });
+
+    for (unsigned int c = 0; c < chunks; ++c) {
+        ChunkBatches& local = chunkScratch[c];
+        local.targets.resize(local.keys.size());
+        local.offsets.resize(local.keys.size());
+        for (unsigned int k = 0; k < local.keys.size(); ++k) {
+            std::vector<InstanceData>& target = batchFor(local.keys[k]).instances;
+            local.targets[k] = &target;
+            local.offsets[k] = target.size();
+            target.resize(target.size() + local.instances[k].size());
+        }
+    }
+
+    JobSystem::parallelFor(chunks, 1, [this](unsigned int first, unsigned int last) {
+        for (unsigned int c = first; c < last; ++c) {
+            const ChunkBatches& local = chunkScratch[c];
+            for (unsigned int k = 0; k < local.keys.size(); ++k) {
+                std::copy(local.instances[k].begin(), local.instances[k].end(), local.targets[k]->begin() + local.offsets[k]);
+            }
+        }
+    });
+}
+
+void InstancedRenderer::submitPoints(const std::vector<Vector3>& positions, const std::vector<Color>& colors, const std::vector<unsigned int>& drawList) {
+    unsigned int first = points.size() / 6;
+    points.resize(points.size() + drawList.size() * 6);
+    float* out = points.data() + first * 6;
+    JobSystem::parallelFor(drawList.size(), FILL_CHUNK, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int n = begin; n < end; ++n) {
+            unsigned int i = drawList[n];
+            float* point = out + n * 6;
+            point[0] = positions[i].x;
+            point[1] = positions[i].y;
+            point[2] = positions[i].z;
+            point[3] = colors[i].r;
+            point[4] = colors[i].g;
+            point[5] = colors[i].b;
+        }
+    });
+}
+
+void InstancedRenderer::bindInstanceAttributes(const Batch& batch) {
+    glBindBuffer(GL_ARRAY_BUFFER, batch.instanceVBO);
+
+    //Position and radius as one vec4 at location 2
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offsetof(InstanceData, position));
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offsetof(InstanceData, color));
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+}
+
+//Expects the FrameUniforms block uploaded
+void InstancedRenderer::draw(const ShaderProgram& litShader, const ShaderProgram& unlitShader) {
+    litShader.use();
+    drawBatches(false);
+    unlitShader.use();
+    drawBatches(true);
+}
+
+void InstancedRenderer::drawBatches(bool unlit) {
+    for (auto& entry : batches) {
+        const Mesh* mesh = entry.first.first;
+        Batch& batch = entry.second;
+        if (entry.first.second != unlit || batch.instances.empty()) {
+            continue;
+        }
+
+        glBindVertexArray(mesh->VAO);
+        //Re-specifying the buffer each frame orphans the old storage instead of waiting on the GPU
+        glBindBuffer(GL_ARRAY_BUFFER, batch.instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, batch.instances.size() * sizeof(InstanceData), batch.instances.data(), GL_STREAM_DRAW);
+        bindInstanceAttributes(batch);
+
+        glDrawElementsInstanced(GL_TRIANGLES, mesh->indexCount, mesh->indexType, 0, batch.instances.size());
+    }
+    glBindVertexArray(0);
+}
+
+void InstancedRenderer::drawPoints() {
+    if (points.empty()) {
+        return;
+    }
+    if (pointVAO == 0) {
+        glGenVertexArrays(1, &pointVAO);
+        glGenBuffers(1, &pointVBO);
+        glBindVertexArray(pointVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, pointVBO);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+    }
+    glBindVertexArray(pointVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, pointVBO);
+    glBufferData(GL_ARRAY_BUFFER, points.size() * sizeof(float), points.data(), GL_STREAM_DRAW);
+    glDrawArrays(GL_POINTS, 0, points.size() / 6);
+    glBindVertexArray(0);
+}
+
+void InstancedRenderer::clear() {
+    for (auto& entry : batches) {
+        glDeleteBuffers(1, &entry.second.instanceVBO);
+    }
+    batches.clear();
+    chunkScratch.clear();
+    if (pointVAO != 0) {
+        glDeleteVertexArrays(1, &pointVAO);
+        glDeleteBuffers(1, &pointVBO);
+        pointVAO = 0;
+        pointVBO = 0;
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef INSTANCEDRENDERER_H
+#define INSTANCEDRENDERER_H
+
+#include <map>
+#include <utility>
+#include <vector>
+#include "Sphere.h"
+#include "MeshCache.h"
+#include "ShaderProgram.h"
+
+//Everything the vertex shader needs to know about one body.
+//Bodies are only ever translated and uniformly scaled, so that is a centre and a radius rather
+//than a model matrix (28 bytes instead of 80) and the shader needs no normal matrix.
+//Layout must match the per-instance attributes in the body vertex shader.
+struct InstanceData {
+	float position[3];
+	float radius;
+	float color[3];
+};
+
+//Collects bodies each frame and draws every body sharing a mesh and shader variant with one
+//glDrawElementsInstanced call, plus one glDrawArrays of points for the bodies culled down to impostors
+class InstancedRenderer {
+private:
+	//Mesh and whether the body is drawn unlit (a star)
+	typedef std::pair<const Mesh*, bool> BatchKey;
+	struct Batch {
+		unsigned int instanceVBO;
+		std::vector<InstanceData> instances;
+	};
+	//Instances one submitDrawList job filled for each batch it came across, before they are copied into the batches
+	struct ChunkBatches {
+		std::vector<BatchKey> keys;
+		std::vector<std::vector<InstanceData>> instances;
+		std::vector<std::vector<InstanceData>*> targets;
+		std::vector<unsigned int> offsets;
+	};
+	std::map<BatchKey, Batch> batches;
+	std::vector<ChunkBatches> chunkScratch;
+	//Position and colour per point, 6 floats each
+	std::vector<float> points;
+	unsigned int pointVAO = 0, pointVBO = 0;
+	Batch& batchFor(BatchKey key);
+	static InstanceData makeInstance(Vector3 pos, float radius, Color color);
+	void drawBatches(bool unlit);
+	void bindInstanceAttributes(const Batch& batch);
+public:
+	//Call at the start of each frame; keeps the vectors' capacity so nothing is reallocated
+	void begin();
+	void submit(const Mesh* mesh, Vector3 pos, float radius, Color color, bool isSun = false);
+	void submit(const Sphere& sphere, bool isSun = false);
+	//Submits spheres[i] at positions[i] for every i in drawList (normally the Culler's visible list),
+	//filling the instance data on the job system. Must be called on the GL thread since it may create buffers.
+	void submitDrawList(const std::vector<Sphere>& spheres, const std::vector<Vector3>& positions, const std::vector<unsigned char>& isSun, const std::vector<unsigned int>& drawList);
+	//Bodies per submitDrawList job
+	static const unsigned int FILL_CHUNK = 4096;
+	//Bodies too small to be worth a mesh, drawn as one pixel each in their own colour
+	void submitPoints(const std::vector<Vector3>& positions, const std::vector<Color>& colors, const std::vector<unsigned int>& drawList);
+	//Lit bodies with the first program, then stars with the second
+	void draw(const ShaderProgram& litShader, const ShaderProgram& unlitShader);
+	//Expects the point shader to be in use
+	void drawPoints();
+	void clear();
+};
+
+#endif
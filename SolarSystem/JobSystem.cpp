@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iterator>
+#include "JobSystem.h"
+#include "Profiler.h"
+
+std::vector<std::unique_ptr<JobSystem::Queue>> JobSystem::queues;
+std::vector<std::thread> JobSystem::threads;
+std::atomic<bool> JobSystem::running(false);
+std::atomic<unsigned int> JobSystem::pending(0);
+std::mutex JobSystem::sleepMutex;
+std::condition_variable JobSystem::wake;
+std::once_flag JobSystem::startFlag;
+
+//Which deque this thread owns; -1 for threads the job system did not start
+static thread_local int workerIndex = -1;
+
+void JobSystem::start(unsigned int threadCount) {
+    std::call_once(startFlag, [threadCount]() {
+        unsigned int count = threadCount > 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+        //Queue 0 belongs to the outside threads, so count queues means count - 1 workers
+        for (unsigned int i = 0; i < count; ++i) {
+            queues.emplace_back(new Queue());
+        }
+        running = true;
+        for (unsigned int i = 1; i < count; ++i) {
+            threads.emplace_back(&JobSystem::workerLoop, i);
+        }
+        //Workers must be joined before the static vectors are destroyed
+        std::atexit(&JobSystem::stop);
+    });
+}
+
+void JobSystem::ensureStarted() {
+    start(0);
+}
+
+void JobSystem::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+}
+
+unsigned int JobSystem::getThreadCount() {
+    ensureStarted();
+    return queues.size();
+}
+
+unsigned int JobSystem::currentQueue() {
+    return workerIndex < 0 ? 0 : (unsigned int)workerIndex;
+}
+
+bool JobSystem::tryRunOne(unsigned int self, const Counter* only) {
+    Job job;
+    bool found = false;
+    {
+        //Own work first, newest job
+        Queue& own = *queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        for (auto it = own.jobs.rbegin(); it != own.jobs.rend(); ++it) {
+            if (only == nullptr || it->counter == only) {
+                job = std::move(*it);
+                own.jobs.erase(std::next(it).base());
+                found = true;
+                break;
+            }
+        }
+    }
+    //Otherwise steal the oldest job from someone else
+    for (unsigned int offset = 1; !found && offset < queues.size(); ++offset) {
+        Queue& victim = *queues[(self + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        for (auto it = victim.jobs.begin(); it != victim.jobs.end(); ++it) {
+            if (only == nullptr || it->counter == only) {
+                job = std::move(*it);
+                victim.jobs.erase(it);
+                found = true;
+                break;
+            }
+        }
+    }
+    if (!found) {
+        return false;
+    }
+
+    --pending;
+    job.function();
+    --(*job.counter);
+    return true;
+}
+
+void JobSystem::workerLoop(unsigned int index) {
+    workerIndex = index;
+    Profiler::setThreadName("worker " + std::to_string(index));
+    while (running) {
+        if (tryRunOne(index)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        //The timeout is only a safety net; run() wakes a worker for every job
+        wake.wait_for(lock, std::chrono::milliseconds(2), []() { return pending > 0 || !running; });
+    }
+}
+
+void JobSystem::run(std::function<void()> job, Counter& counter) {
+    ensureStarted();
+    ++counter;
+    //Counted before it is queued, so a thief can never take pending below zero
+    ++pending;
+    {
+        Queue& queue = *queues[currentQueue()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(Job{ std::move(job), &counter });
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_one();
+}
+
+void JobSystem::wait(Counter& counter) {
+    ensureStarted();
+    unsigned int self = currentQueue();
+    //Only this counter's jobs: anything else queued here (such as the simulation step the render thread
+    //hands off) could be long, and running it inline would hold up whoever is waiting
+    while (counter > 0) {
+        if (!tryRunOne(self, &counter)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::parallelFor(unsigned int count, unsigned int chunkSize, const std::function<void(unsigned int, unsigned int)>& body) {
+    chunkSize = std::max(1u, chunkSize);
+    if (count <= chunkSize || getThreadCount() == 1) {
+        if (count > 0) {
+            body(0, count);
+        }
+        return;
+    }
+
+    Counter counter(0);
+    //The first chunk is kept for this thread, the rest can be stolen
+    for (unsigned int begin = chunkSize; begin < count; begin += chunkSize) {
+        unsigned int end = std::min(begin + chunkSize, count);
+        run([&body, begin, end]() { body(begin, end); }, counter);
+    }
+    body(0, chunkSize);
+    wait(counter);
+}
@@ -0,0 +1,60 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//Work-stealing job scheduler shared by the whole program.
+//
+//Each worker has its own deque: it pushes and pops at the back (newest first, still hot in cache)
+//and idle workers steal from the front of someone else's. Threads that are not workers
+//(the main thread) share deque 0. Waiting on a counter never blocks: the waiting thread
+//runs that counter's queued jobs itself until they are done, so jobs can safely wait on jobs they
+//spawned, but it never picks up unrelated work.
+//
+//Started lazily with one worker per hardware thread (minus the caller) the first time it is used.
+class JobSystem {
+public:
+	//Number of jobs still to finish; run() increments it and each job decrements it when done
+	typedef std::atomic<unsigned int> Counter;
+private:
+	struct Job {
+		std::function<void()> function;
+		Counter* counter;
+	};
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+	static std::vector<std::unique_ptr<Queue>> queues;
+	static std::vector<std::thread> threads;
+	static std::atomic<bool> running;
+	static std::atomic<unsigned int> pending;
+	static std::mutex sleepMutex;
+	static std::condition_variable wake;
+	static std::once_flag startFlag;
+	static void ensureStarted();
+	static void workerLoop(unsigned int index);
+	//Runs one queued job, only one counted by only unless that is null
+	static bool tryRunOne(unsigned int self, const Counter* only = nullptr);
+	static unsigned int currentQueue();
+public:
+	//threadCount includes the calling thread; 0 means one per hardware thread.
+	//Only has an effect before the first job is scheduled.
+	static void start(unsigned int threadCount = 0);
+	static void stop();
+	static unsigned int getThreadCount();
+	static void run(std::function<void()> job, Counter& counter);
+	static void wait(Counter& counter);
+	//Calls body(begin, end) over [0, count) in chunks of chunkSize, spread across the workers,
+	//and returns when every chunk is done
+	static void parallelFor(unsigned int count, unsigned int chunkSize, const std::function<void(unsigned int, unsigned int)>& body);
+};
+
+#endif
@@ -0,0 +1,44 @@
+#include "LodSelector.h"
+#include "JobSystem.h"
+
+LodSelector::LodSelector() {
+    hysteresis = 0.15f;
+    setChain({ 8, 12, 20, 32, 48 });
+}
+
+void LodSelector::setChain(const std::vector<unsigned int>& levelDivisions) {
+    divisions = levelDivisions;
+    maxPixelRadius.resize(divisions.size());
+    for (unsigned int level = 0; level < divisions.size(); ++level) {
+        maxPixelRadius[level] = 1.25f * divisions[level];
+    }
+    //Old levels may point past the new chain
+    levels.assign(levels.size(), NO_LEVEL);
+}
+
+unsigned char LodSelector::chooseLevel(float pixelRadius, unsigned char current) const {
+    unsigned int last = divisions.size() - 1;
+    unsigned int ideal = 0;
+    while (ideal < last && pixelRadius > maxPixelRadius[ideal]) {
+        ++ideal;
+    }
+    if (current == NO_LEVEL || current > last || ideal == current) {
+        return ideal;
+    }
+    if (ideal > current) {
+        //Finer only once clearly past the top of the current level
+        return pixelRadius > maxPixelRadius[current] * (1.0f + hysteresis) ? ideal : current;
+    }
+    //Coarser only once clearly below the top of the level underneath
+    return pixelRadius < maxPixelRadius[current - 1] * (1.0f - hysteresis) ? ideal : current;
+}
+
+void LodSelector::select(const Vector3* positions, const float* radii, const std::vector<unsigned int>& drawList, const Culler& culler, unsigned int bodyCount) {
+    levels.resize(bodyCount, NO_LEVEL);
+    JobSystem::parallelFor(drawList.size(), SELECT_CHUNK, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int n = begin; n < end; ++n) {
+            unsigned int i = drawList[n];
+            levels[i] = chooseLevel(culler.projectedRadius(positions[i], radii[i]), levels[i]);
+        }
+    });
+}
@@ -0,0 +1,40 @@
+#ifndef LODSELECTOR_H
+#define LODSELECTOR_H
+
+#include <vector>
+#include "BodyTypes.h"
+#include "Culler.h"
+
+//Picks a tessellation for every visible body from how big it is on screen.
+//
+//The chain runs from coarse to fine; level k is good up to maxPixelRadius[k] (about 1.25 pixels
+//of projected radius per division, so each edge stays around five pixels long). A body only
+//moves to another level once it is past the boundary by the hysteresis fraction, so a body
+//sitting right on a boundary does not flicker between two meshes. Has no OpenGL dependency;
+//the Window maps levels to meshes.
+class LodSelector {
+private:
+	std::vector<unsigned int> divisions;
+	std::vector<float> maxPixelRadius;
+	float hysteresis;
+	//Per body id, NO_LEVEL until it is first seen
+	std::vector<unsigned char> levels;
+public:
+	static constexpr unsigned char NO_LEVEL = 255;
+	//Bodies per job
+	static const unsigned int SELECT_CHUNK = 16384;
+	//The default chain is 8, 12, 20, 32 and 48 divisions with 15% hysteresis
+	LodSelector();
+	//Divisions per level, coarse to fine (at most 254 levels)
+	void setChain(const std::vector<unsigned int>& levelDivisions);
+	void setHysteresis(float fraction) { hysteresis = fraction; }
+	unsigned int getLevelCount() const { return divisions.size(); }
+	unsigned int getDivisions(unsigned int level) const { return divisions[level]; }
+	//The level for a body of this projected radius that is currently at `current`
+	unsigned char chooseLevel(float pixelRadius, unsigned char current) const;
+	//Updates the level of every body in drawList. bodyCount is the total number of bodies.
+	void select(const Vector3* positions, const float* radii, const std::vector<unsigned int>& drawList, const Culler& culler, unsigned int bodyCount);
+	const std::vector<unsigned char>& getLevels() const { return levels; }
+};
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <cstddef>
+
+//Read-only memory mapping of a whole file (mmap on POSIX, a file mapping on Windows).
+//Pages are only read from disk as they are first touched.
+class MappedFile {
+private:
+	const unsigned char* data;
+	size_t length;
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fileDescriptor;
+#endif
+public:
+	MappedFile();
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	bool open(const std::string& path);
+	void close();
+	const unsigned char* getData() const { return data; }
+	size_t size() const { return length; }
+};
+
+#endif
@@ -0,0 +1,285 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "MeshBuilder.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+void MeshBuilder::generateSphere(std::vector<float>& positions, std::vector<uint32_t>& indices, unsigned int latDivisions, unsigned int longDivisions) {
+    latDivisions = std::max(2u, latDivisions);
+    longDivisions = std::max(3u, longDivisions);
+    positions.clear();
+    indices.clear();
+
+    //North pole, then latDivisions - 1 rings of longDivisions vertices, then the south pole
+    positions.push_back(0.0f);
+    positions.push_back(1.0f);
+    positions.push_back(0.0f);
+    for (unsigned int lat = 1; lat < latDivisions; ++lat) {
+        double theta = lat * M_PI / latDivisions;
+        for (unsigned int lon = 0; lon < longDivisions; ++lon) {
+            double phi = lon * 2.0 * M_PI / longDivisions;
+            positions.push_back((float)(std::cos(phi) * std::sin(theta)));
+            positions.push_back((float)std::cos(theta));
+            positions.push_back((float)(std::sin(phi) * std::sin(theta)));
+        }
+    }
+    positions.push_back(0.0f);
+    positions.push_back(-1.0f);
+    positions.push_back(0.0f);
+
+    uint32_t southPole = 1 + (latDivisions - 1) * longDivisions;
+    auto ring = [longDivisions](unsigned int lat, unsigned int lon) {
+        return (uint32_t)(1 + (lat - 1) * longDivisions + lon % longDivisions);
+    };
+
+    //Counter-clockwise from outside: going east (+phi) runs from +x towards +z
+    for (unsigned int lon = 0; lon < longDivisions; ++lon) {
+        indices.push_back(0);
+        indices.push_back(ring(1, lon + 1));
+        indices.push_back(ring(1, lon));
+    }
+    for (unsigned int lat = 1; lat + 1 < latDivisions; ++lat) {
+        for (unsigned int lon = 0; lon < longDivisions; ++lon) {
+            uint32_t first = ring(lat, lon);
+            uint32_t second = ring(lat + 1, lon);
+            uint32_t firstNext = ring(lat, lon + 1);
+            uint32_t secondNext = ring(lat + 1, lon + 1);
+
+            indices.push_back(first);
+            indices.push_back(firstNext);
+            indices.push_back(second);
+
+            indices.push_back(second);
+            indices.push_back(firstNext);
+            indices.push_back(secondNext);
+        }
+    }
+    for (unsigned int lon = 0; lon < longDivisions; ++lon) {
+        indices.push_back(southPole);
+        indices.push_back(ring(latDivisions - 1, lon));
+        indices.push_back(ring(latDivisions - 1, lon + 1));
+    }
+}
+
+//Forsyth, "Linear-Speed Vertex Cache Optimisation" (2006): greedily emit the triangle whose
+//vertices score highest, where recently used vertices and vertices with few triangles left score well
+static const float CACHE_DECAY_POWER = 1.5f;
+static const float LAST_TRIANGLE_SCORE = 0.75f;
+static const float VALENCE_BOOST_SCALE = 2.0f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+
+static float vertexScore(int cachePosition, unsigned int remainingTriangles) {
+    if (remainingTriangles == 0) {
+        return -1.0f;
+    }
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            //Used by the triangle just emitted; a fixed score stops it being favoured too much
+            score = LAST_TRIANGLE_SCORE;
+        }
+        else {
+            float scaled = 1.0f - (float)(cachePosition - 3) / (MeshBuilder::CACHE_SIZE - 3);
+            score = std::pow(scaled, CACHE_DECAY_POWER);
+        }
+    }
+    //Vertices with few triangles left are finished off before they fall out of the cache
+    score += VALENCE_BOOST_SCALE * std::pow((float)remainingTriangles, -VALENCE_BOOST_POWER);
+    return score;
+}
+
+void MeshBuilder::optimizeVertexCache(std::vector<uint32_t>& indices, unsigned int vertexCount) {
+    unsigned int triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    //Triangles around each vertex, flattened
+    std::vector<unsigned int> remaining(vertexCount, 0);
+    for (uint32_t index : indices) {
+        ++remaining[index];
+    }
+    std::vector<unsigned int> adjacencyStart(vertexCount + 1, 0);
+    for (unsigned int v = 0; v < vertexCount; ++v) {
+        adjacencyStart[v + 1] = adjacencyStart[v] + remaining[v];
+    }
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+    for (unsigned int t = 0; t < triangleCount; ++t) {
+        for (unsigned int k = 0; k < 3; ++k) {
+            adjacency[fill[indices[t * 3 + k]]++] = t;
+        }
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (unsigned int v = 0; v < vertexCount; ++v) {
+        score[v] = vertexScore(-1, remaining[v]);
+    }
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for (unsigned int t = 0; t < triangleCount; ++t) {
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+    }
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    //Most recent first; three slots past the end hold the vertices being pushed out
+    std::vector<uint32_t> cache;
+    cache.reserve(CACHE_SIZE + 3);
+    unsigned int scanFrom = 0;
+    int best = 0;
+    for (unsigned int t = 1; t < triangleCount; ++t) {
+        if (triangleScore[t] > triangleScore[best]) {
+            best = t;
+        }
+    }
+
+    while (best >= 0) {
+        emitted[best] = true;
+        std::vector<uint32_t> newCache;
+        newCache.reserve(CACHE_SIZE + 3);
+        for (unsigned int k = 0; k < 3; ++k) {
+            uint32_t v = indices[best * 3 + k];
+            output.push_back(v);
+            newCache.push_back(v);
+            --remaining[v];
+        }
+        for (uint32_t v : cache) {
+            if (v != newCache[0] && v != newCache[1] && v != newCache[2]) {
+                newCache.push_back(v);
+            }
+        }
+        cache.swap(newCache);
+
+        //Rescore everything in (or just pushed out of) the cache and the triangles around it
+        for (unsigned int i = 0; i < cache.size(); ++i) {
+            uint32_t v = cache[i];
+            cachePosition[v] = i < CACHE_SIZE ? (int)i : -1;
+            score[v] = vertexScore(cachePosition[v], remaining[v]);
+        }
+        best = -1;
+        float bestScore = -1.0f;
+        for (uint32_t v : cache) {
+            for (unsigned int a = adjacencyStart[v]; a < adjacencyStart[v + 1]; ++a) {
+                unsigned int t = adjacency[a];
+                if (emitted[t]) {
+                    continue;
+                }
+                triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+        if (cache.size() > CACHE_SIZE) {
+            cache.resize(CACHE_SIZE);
+        }
+
+        //Nothing left touching the cache: carry on from the next unemitted triangle
+        if (best < 0) {
+            while (scanFrom < triangleCount && emitted[scanFrom]) {
+                ++scanFrom;
+            }
+            best = scanFrom < triangleCount ? (int)scanFrom : -1;
+        }
+    }
+    indices.swap(output);
+}
+
+void MeshBuilder::optimizeVertexFetch(std::vector<uint32_t>& indices, unsigned int vertexCount, std::vector<uint32_t>& remap) {
+    const uint32_t unused = 0xffffffffu;
+    remap.assign(vertexCount, unused);
+    uint32_t next = 0;
+    for (uint32_t& index : indices) {
+        if (remap[index] == unused) {
+            remap[index] = next++;
+        }
+        index = remap[index];
+    }
+    //Vertices no triangle uses go at the end
+    for (uint32_t& slot : remap) {
+        if (slot == unused) {
+            slot = next++;
+        }
+    }
+}
+
+float MeshBuilder::computeACMR(const std::vector<uint32_t>& indices, unsigned int cacheSize) {
+    if (indices.empty()) {
+        return 0.0f;
+    }
+    std::vector<uint32_t> fifo(cacheSize, 0xffffffffu);
+    unsigned int head = 0, misses = 0;
+    for (uint32_t index : indices) {
+        if (std::find(fifo.begin(), fifo.end(), index) == fifo.end()) {
+            fifo[head] = index;
+            head = (head + 1) % cacheSize;
+            ++misses;
+        }
+    }
+    return (float)misses / (indices.size() / 3);
+}
+
+uint32_t MeshBuilder::packNormal(float x, float y, float z) {
+    //Signed 10-bit fields, x in the low bits (GL_INT_2_10_10_10_REV), w left at 0
+    auto field = [](float value) {
+        int scaled = (int)std::lround(std::min(1.0f, std::max(-1.0f, value)) * 511.0f);
+        return (uint32_t)scaled & 0x3ffu;
+    };
+    return field(x) | field(y) << 10 | field(z) << 20;
+}
+
+MeshData MeshBuilder::buildSphere(unsigned int latDivisions, unsigned int longDivisions, VertexFormat format, bool optimize) {
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    generateSphere(positions, indices, latDivisions, longDivisions);
+    unsigned int vertexCount = positions.size() / 3;
+
+    std::vector<uint32_t> remap(vertexCount);
+    if (optimize) {
+        //Coarse spheres in ring order already fit a small cache; keep whichever order misses less
+        std::vector<uint32_t> reordered = indices;
+        optimizeVertexCache(reordered, vertexCount);
+        if (computeACMR(reordered, MEASURE_CACHE_SIZE) < computeACMR(indices, MEASURE_CACHE_SIZE)) {
+            indices.swap(reordered);
+        }
+        optimizeVertexFetch(indices, vertexCount, remap);
+    }
+    else {
+        for (unsigned int v = 0; v < vertexCount; ++v) {
+            remap[v] = v;
+        }
+    }
+
+    MeshData mesh;
+    mesh.format = format;
+    mesh.vertexStride = format == PACKED_NORMALS ? 16 : 24;
+    mesh.vertexCount = vertexCount;
+    mesh.vertices.resize(vertexCount * mesh.vertexStride);
+    for (unsigned int v = 0; v < vertexCount; ++v) {
+        unsigned char* out = mesh.vertices.data() + remap[v] * mesh.vertexStride;
+        const float* p = &positions[v * 3];
+        //On a unit sphere the normal is the position
+        std::memcpy(out, p, 3 * sizeof(float));
+        if (format == PACKED_NORMALS) {
+            uint32_t packed = packNormal(p[0], p[1], p[2]);
+            std::memcpy(out + 12, &packed, sizeof(packed));
+        }
+        else {
+            std::memcpy(out + 12, p, 3 * sizeof(float));
+        }
+    }
+
+    if (vertexCount <= 0xffff) {
+        mesh.indices16.assign(indices.begin(), indices.end());
+    }
+    else {
+        mesh.indices32.swap(indices);
+    }
+    return mesh;
+}
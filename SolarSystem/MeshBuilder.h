@@ -0,0 +1,52 @@
+#ifndef MESHBUILDER_H
+#define MESHBUILDER_H
+
+#include <vector>
+#include <cstdint>
+
+//Vertex layouts a mesh can be built in. Position is always three floats at offset 0.
+enum VertexFormat {
+	FLOAT_NORMALS,		//Normal as three floats: 24 bytes per vertex
+	PACKED_NORMALS		//Normal as signed normalized 2_10_10_10: 16 bytes per vertex
+};
+
+//A mesh ready to upload: interleaved vertices and either 16 or 32-bit indices
+struct MeshData {
+	VertexFormat format;
+	unsigned int vertexStride;
+	unsigned int vertexCount;
+	std::vector<unsigned char> vertices;
+	//Only one of these is filled; 16-bit whenever every index fits
+	std::vector<uint16_t> indices16;
+	std::vector<uint32_t> indices32;
+	unsigned int indexCount() const { return indices16.empty() ? indices32.size() : indices16.size(); }
+	unsigned int indexSize() const { return indices16.empty() ? 4 : 2; }
+};
+
+//Builds sphere meshes on the CPU, with no OpenGL dependency so the results can be measured headless.
+//
+//The sphere has one vertex per pole and no duplicated seam column (nothing is textured), with
+//triangle fans at the poles and counter-clockwise winding seen from outside. Triangles are then
+//reordered for the post-transform vertex cache with Forsyth's linear-speed algorithm, and vertices
+//are renumbered in order of first use so fetches walk the vertex buffer forwards.
+class MeshBuilder {
+public:
+	//Cache size Forsyth's scoring models; covers current GPUs' effective reuse window
+	static const unsigned int CACHE_SIZE = 32;
+	//Smaller FIFO used to judge an ordering, so a win has to hold on older hardware too
+	static const unsigned int MEASURE_CACHE_SIZE = 16;
+	//Unit sphere; radius comes from the model matrix
+	static MeshData buildSphere(unsigned int latDivisions, unsigned int longDivisions, VertexFormat format = PACKED_NORMALS, bool optimize = true);
+	//Positions (and normals, which are the same on a unit sphere) and triangle indices before any reordering
+	static void generateSphere(std::vector<float>& positions, std::vector<uint32_t>& indices, unsigned int latDivisions, unsigned int longDivisions);
+	//Reorders the triangles of an indexed mesh in place for vertex cache reuse
+	static void optimizeVertexCache(std::vector<uint32_t>& indices, unsigned int vertexCount);
+	//Renumbers vertices in order of first use; remap[old] = new
+	static void optimizeVertexFetch(std::vector<uint32_t>& indices, unsigned int vertexCount, std::vector<uint32_t>& remap);
+	//Average cache miss ratio: vertices transformed per triangle through a FIFO cache of cacheSize entries.
+	//0.5 is the ideal for a large regular mesh, 3 means no reuse at all
+	static float computeACMR(const std::vector<uint32_t>& indices, unsigned int cacheSize);
+	static uint32_t packNormal(float x, float y, float z);
+};
+
+#endif
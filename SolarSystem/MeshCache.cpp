@@ -0,0 +1,71 @@
+#include<glad.h>
+#include<GLFW/glfw3.h>
+
+#include "MeshCache.h"
+
+std::map<std::pair<unsigned int, unsigned int>, Mesh> MeshCache::meshes;
+VertexFormat MeshCache::vertexFormat = PACKED_NORMALS;
+
+Mesh MeshCache::uploadMesh(const MeshData& data) {
+    Mesh mesh;
+    glGenVertexArrays(1, &mesh.VAO);
+    glGenBuffers(1, &mesh.VBO);
+    glGenBuffers(1, &mesh.EBO);
+
+    glBindVertexArray(mesh.VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+    glBufferData(GL_ARRAY_BUFFER, data.vertices.size(), data.vertices.data(), GL_STATIC_DRAW);
+
+    //Half the index bandwidth whenever every vertex can be addressed in 16 bits
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+    if (data.indexSize() == 2) {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, data.indices16.size() * sizeof(uint16_t), data.indices16.data(), GL_STATIC_DRAW);
+        mesh.indexType = GL_UNSIGNED_SHORT;
+    }
+    else {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, data.indices32.size() * sizeof(uint32_t), data.indices32.data(), GL_STATIC_DRAW);
+        mesh.indexType = GL_UNSIGNED_INT;
+    }
+
+    // Position attribute
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, data.vertexStride, (void*)0);
+    glEnableVertexAttribArray(0);
+
+    // Normal attribute: the shader sees a vec3 either way
+    if (data.format == PACKED_NORMALS) {
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, data.vertexStride, (void*)(3 * sizeof(float)));
+    }
+    else {
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, data.vertexStride, (void*)(3 * sizeof(float)));
+    }
+    glEnableVertexAttribArray(1);
+
+    glBindVertexArray(0); // Unbind VAO
+
+    mesh.indexCount = data.indexCount();
+    return mesh;
+}
+
+const Mesh* MeshCache::getSphere(unsigned int latDivisions, unsigned int longDivisions) {
+    std::pair<unsigned int, unsigned int> key(latDivisions, longDivisions);
+    auto found = meshes.find(key);
+    if (found != meshes.end()) {
+        return &found->second;
+    }
+
+    //The CPU copy only lives long enough to be uploaded
+    MeshData data = MeshBuilder::buildSphere(latDivisions, longDivisions, vertexFormat);
+
+    //std::map never moves its elements, so the pointer stays valid as more meshes are added
+    return &meshes.emplace(key, uploadMesh(data)).first->second;
+}
+
+void MeshCache::clear() {
+    for (auto& entry : meshes) {
+        glDeleteVertexArrays(1, &entry.second.VAO);
+        glDeleteBuffers(1, &entry.second.VBO);
+        glDeleteBuffers(1, &entry.second.EBO);
+    }
+    meshes.clear();
+}
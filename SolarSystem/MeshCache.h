@@ -0,0 +1,33 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <map>
+#include <utility>
+#include <vector>
+#include "MeshBuilder.h"
+
+//A unit sphere that has been uploaded to the GPU.
+//Bodies scale it to their own radius with the model matrix.
+struct Mesh {
+	unsigned int VAO, VBO, EBO;
+	unsigned int indexCount;
+	//GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, whichever the mesh was built with
+	unsigned int indexType;
+};
+
+//Builds each tessellation once and hands out the same Mesh to every body that asks for it.
+//Keyed by (latDivisions, longDivisions) so memory grows with distinct tessellations, not with bodies.
+class MeshCache {
+private:
+	static std::map<std::pair<unsigned int, unsigned int>, Mesh> meshes;
+	static VertexFormat vertexFormat;
+	static Mesh uploadMesh(const MeshData& data);
+public:
+	//Layout for meshes built from now on; packed normals (16 bytes per vertex) by default
+	static void setVertexFormat(VertexFormat format) { vertexFormat = format; }
+	//Needs a current OpenGL context the first time a tessellation is requested
+	static const Mesh* getSphere(unsigned int latDivisions, unsigned int longDivisions);
+	static void clear();
+};
+
+#endif
@@ -0,0 +1,246 @@
+#include <cmath>
+#include "OrbitKernel.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ORBIT_KERNEL_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+//MSVC lets any function use AVX2 intrinsics; GCC and Clang need the target enabled per function
+#if defined(__GNUC__) || defined(__clang__)
+#define ORBIT_KERNEL_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define ORBIT_KERNEL_AVX2
+#endif
+
+static const float TWO_OVER_PI = 0.63661977236758134308f;
+//pi/2 split into three parts so k * pi/2 can be subtracted without losing bits (Cody-Waite)
+static const float PIO2_1 = 1.5703125f;
+static const float PIO2_2 = 4.837512969970703125e-4f;
+static const float PIO2_3 = 7.54978995489188216e-8f;
+//Minimax coefficients for sin and cos on [-pi/4, pi/4] (Cephes sinf/cosf)
+static const float SIN_1 = -1.6666654611e-1f;
+static const float SIN_2 = 8.3321608736e-3f;
+static const float SIN_3 = -1.9515295891e-4f;
+static const float COS_1 = 4.166664568298827e-2f;
+static const float COS_2 = -1.388731625493765e-3f;
+static const float COS_3 = 2.443315711809948e-5f;
+
+const char* OrbitKernel::kernelName = nullptr;
+
+void OrbitKernel::sinCos(float x, float& s, float& c) {
+    //Reduce to r in [-pi/4, pi/4] and a quadrant k
+    float kf = std::nearbyint(x * TWO_OVER_PI);
+    int k = (int)kf;
+    float r = x - kf * PIO2_1;
+    r -= kf * PIO2_2;
+    r -= kf * PIO2_3;
+
+    float r2 = r * r;
+    float sinR = r + r * r2 * (SIN_1 + r2 * (SIN_2 + r2 * SIN_3));
+    float cosR = 1.0f - 0.5f * r2 + r2 * r2 * (COS_1 + r2 * (COS_2 + r2 * COS_3));
+
+    //Quadrant 1 and 3 swap sin and cos; the sign flips every second quadrant
+    if (k & 1) {
+        float t = sinR;
+        sinR = cosR;
+        cosR = t;
+    }
+    s = (k & 2) ? -sinR : sinR;
+    c = ((k + 1) & 2) ? -cosR : cosR;
+}
+
+void OrbitKernel::solveKeplerScalar(const float* meanAnomaly, const float* eccentricity, const float* semiMajor, const float* semiMinor, float* outX, float* outY, unsigned int count) {
+    for (unsigned int i = 0; i < count; ++i) {
+        float m = meanAnomaly[i];
+        float e = eccentricity[i];
+        float s, c;
+        sinCos(m, s, c);
+        if (e > 0.0f) {
+            //Second order series for gentle orbits; Danby's start keeps Newton stable near e = 1
+            float eccentricAnomaly = e < 0.8f ? m + e * s * (1.0f + e * c) : m + std::copysign(0.85f * e, s);
+            for (unsigned int k = 0; k < KEPLER_ITERATIONS; ++k) {
+                sinCos(eccentricAnomaly, s, c);
+                eccentricAnomaly -= (eccentricAnomaly - e * s - m) / (1.0f - e * c);
+            }
+            sinCos(eccentricAnomaly, s, c);
+        }
+        outX[i] = semiMajor[i] * (c - e);
+        outY[i] = semiMinor[i] * s;
+    }
+}
+
+#ifdef ORBIT_KERNEL_X86
+
+static inline void sinCosSSE2(__m128 x, __m128& s, __m128& c) {
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i two = _mm_set1_epi32(2);
+
+    //cvtps_epi32 rounds to nearest under the default MXCSR mode
+    __m128i k = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(TWO_OVER_PI)));
+    __m128 kf = _mm_cvtepi32_ps(k);
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(kf, _mm_set1_ps(PIO2_1)));
+    r = _mm_sub_ps(r, _mm_mul_ps(kf, _mm_set1_ps(PIO2_2)));
+    r = _mm_sub_ps(r, _mm_mul_ps(kf, _mm_set1_ps(PIO2_3)));
+
+    __m128 r2 = _mm_mul_ps(r, r);
+    __m128 sinPoly = _mm_add_ps(_mm_set1_ps(SIN_2), _mm_mul_ps(r2, _mm_set1_ps(SIN_3)));
+    sinPoly = _mm_add_ps(_mm_set1_ps(SIN_1), _mm_mul_ps(r2, sinPoly));
+    __m128 sinR = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), sinPoly));
+    __m128 cosPoly = _mm_add_ps(_mm_set1_ps(COS_2), _mm_mul_ps(r2, _mm_set1_ps(COS_3)));
+    cosPoly = _mm_add_ps(_mm_set1_ps(COS_1), _mm_mul_ps(r2, cosPoly));
+    __m128 cosR = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), r2)), _mm_mul_ps(_mm_mul_ps(r2, r2), cosPoly));
+
+    //SSE2 has no blendv, so select with and/andnot
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(k, one), one));
+    s = _mm_or_ps(_mm_and_ps(swap, cosR), _mm_andnot_ps(swap, sinR));
+    c = _mm_or_ps(_mm_and_ps(swap, sinR), _mm_andnot_ps(swap, cosR));
+    s = _mm_xor_ps(s, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(k, two), 30)));
+    c = _mm_xor_ps(c, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(k, one), two), 30)));
+}
+
+static void solveKeplerSSE2(const float* meanAnomaly, const float* eccentricity, const float* semiMajor, const float* semiMinor, float* outX, float* outY, unsigned int count) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 oneF = _mm_set1_ps(1.0f);
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+
+    unsigned int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 m = _mm_loadu_ps(meanAnomaly + i);
+        __m128 e = _mm_loadu_ps(eccentricity + i);
+        __m128 s, c;
+        sinCosSSE2(m, s, c);
+        //Circular orbits (the common case) need no iterations at all
+        if (_mm_movemask_ps(_mm_cmpgt_ps(e, zero)) != 0) {
+            __m128 gentle = _mm_add_ps(m, _mm_mul_ps(_mm_mul_ps(e, s), _mm_add_ps(oneF, _mm_mul_ps(e, c))));
+            __m128 steep = _mm_add_ps(m, _mm_or_ps(_mm_and_ps(s, signMask), _mm_mul_ps(_mm_set1_ps(0.85f), e)));
+            __m128 useGentle = _mm_cmplt_ps(e, _mm_set1_ps(0.8f));
+            __m128 ea = _mm_or_ps(_mm_and_ps(useGentle, gentle), _mm_andnot_ps(useGentle, steep));
+            for (unsigned int k = 0; k < OrbitKernel::KEPLER_ITERATIONS; ++k) {
+                sinCosSSE2(ea, s, c);
+                __m128 f = _mm_sub_ps(_mm_sub_ps(ea, _mm_mul_ps(e, s)), m);
+                __m128 slope = _mm_sub_ps(oneF, _mm_mul_ps(e, c));
+                ea = _mm_sub_ps(ea, _mm_div_ps(f, slope));
+            }
+            sinCosSSE2(ea, s, c);
+        }
+        _mm_storeu_ps(outX + i, _mm_mul_ps(_mm_loadu_ps(semiMajor + i), _mm_sub_ps(c, e)));
+        _mm_storeu_ps(outY + i, _mm_mul_ps(_mm_loadu_ps(semiMinor + i), s));
+    }
+    OrbitKernel::solveKeplerScalar(meanAnomaly + i, eccentricity + i, semiMajor + i, semiMinor + i, outX + i, outY + i, count - i);
+}
+
+ORBIT_KERNEL_AVX2 static inline void sinCosAVX2(__m256 x, __m256& s, __m256& c) {
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i two = _mm256_set1_epi32(2);
+    const int nearest = _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC;
+
+    __m256 kf = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(TWO_OVER_PI)), nearest);
+    __m256i k = _mm256_cvtps_epi32(kf);
+    __m256 r = _mm256_fnmadd_ps(kf, _mm256_set1_ps(PIO2_1), x);
+    r = _mm256_fnmadd_ps(kf, _mm256_set1_ps(PIO2_2), r);
+    r = _mm256_fnmadd_ps(kf, _mm256_set1_ps(PIO2_3), r);
+
+    __m256 r2 = _mm256_mul_ps(r, r);
+    __m256 sinPoly = _mm256_fmadd_ps(r2, _mm256_set1_ps(SIN_3), _mm256_set1_ps(SIN_2));
+    sinPoly = _mm256_fmadd_ps(r2, sinPoly, _mm256_set1_ps(SIN_1));
+    __m256 sinR = _mm256_fmadd_ps(_mm256_mul_ps(r, r2), sinPoly, r);
+    __m256 cosPoly = _mm256_fmadd_ps(r2, _mm256_set1_ps(COS_3), _mm256_set1_ps(COS_2));
+    cosPoly = _mm256_fmadd_ps(r2, cosPoly, _mm256_set1_ps(COS_1));
+    __m256 cosR = _mm256_fmadd_ps(_mm256_mul_ps(r2, r2), cosPoly, _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), r2, _mm256_set1_ps(1.0f)));
+
+    __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(k, one), one));
+    s = _mm256_blendv_ps(sinR, cosR, swap);
+    c = _mm256_blendv_ps(cosR, sinR, swap);
+    s = _mm256_xor_ps(s, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(k, two), 30)));
+    c = _mm256_xor_ps(c, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(k, one), two), 30)));
+}
+
+ORBIT_KERNEL_AVX2 static inline void solveKeplerAVX2Block(const float* meanAnomaly, const float* eccentricity, const float* semiMajor, const float* semiMinor, float* outX, float* outY) {
+    const __m256 oneF = _mm256_set1_ps(1.0f);
+
+    __m256 m = _mm256_loadu_ps(meanAnomaly);
+    __m256 e = _mm256_loadu_ps(eccentricity);
+    __m256 s, c;
+    sinCosAVX2(m, s, c);
+    //Circular orbits (the common case) need no iterations at all
+    if (_mm256_movemask_ps(_mm256_cmp_ps(e, _mm256_setzero_ps(), _CMP_GT_OQ)) != 0) {
+        __m256 gentle = _mm256_fmadd_ps(_mm256_mul_ps(e, s), _mm256_fmadd_ps(e, c, oneF), m);
+        __m256 steep = _mm256_add_ps(m, _mm256_or_ps(_mm256_and_ps(s, _mm256_set1_ps(-0.0f)), _mm256_mul_ps(_mm256_set1_ps(0.85f), e)));
+        __m256 ea = _mm256_blendv_ps(steep, gentle, _mm256_cmp_ps(e, _mm256_set1_ps(0.8f), _CMP_LT_OQ));
+        for (unsigned int k = 0; k < OrbitKernel::KEPLER_ITERATIONS; ++k) {
+            sinCosAVX2(ea, s, c);
+            __m256 f = _mm256_sub_ps(_mm256_fnmadd_ps(e, s, ea), m);
+            __m256 slope = _mm256_fnmadd_ps(e, c, oneF);
+            ea = _mm256_sub_ps(ea, _mm256_div_ps(f, slope));
+        }
+        sinCosAVX2(ea, s, c);
+    }
+    _mm256_storeu_ps(outX, _mm256_mul_ps(_mm256_loadu_ps(semiMajor), _mm256_sub_ps(c, e)));
+    _mm256_storeu_ps(outY, _mm256_mul_ps(_mm256_loadu_ps(semiMinor), s));
+}
+
+ORBIT_KERNEL_AVX2 static void solveKeplerAVX2(const float* meanAnomaly, const float* eccentricity, const float* semiMajor, const float* semiMinor, float* outX, float* outY, unsigned int count) {
+    //Two independent blocks of 8 per iteration keep both FMA ports busy
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        solveKeplerAVX2Block(meanAnomaly + i, eccentricity + i, semiMajor + i, semiMinor + i, outX + i, outY + i);
+        solveKeplerAVX2Block(meanAnomaly + i + 8, eccentricity + i + 8, semiMajor + i + 8, semiMinor + i + 8, outX + i + 8, outY + i + 8);
+    }
+    for (; i + 8 <= count; i += 8) {
+        solveKeplerAVX2Block(meanAnomaly + i, eccentricity + i, semiMajor + i, semiMinor + i, outX + i, outY + i);
+    }
+    OrbitKernel::solveKeplerScalar(meanAnomaly + i, eccentricity + i, semiMajor + i, semiMinor + i, outX + i, outY + i, count - i);
+}
+
+static bool cpuHasAVX2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    bool avx2 = (info[1] & (1 << 5)) != 0;
+    __cpuid(info, 1);
+    bool fma = (info[2] & (1 << 12)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    //The OS must also save the upper halves of the ymm registers
+    return avx2 && fma && osxsave && (_xgetbv(0) & 6) == 6;
+#else
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+
+#endif
+
+OrbitKernel::SolveFn OrbitKernel::selectKernel() {
+#ifdef ORBIT_KERNEL_X86
+    if (cpuHasAVX2()) {
+        kernelName = "avx2";
+        return solveKeplerAVX2;
+    }
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    kernelName = "sse2";
+    return solveKeplerSSE2;
+#endif
+#endif
+    kernelName = "scalar";
+    return solveKeplerScalar;
+}
+
+void OrbitKernel::solveKepler(const float* meanAnomaly, const float* eccentricity, const float* semiMajor, const float* semiMinor, float* outX, float* outY, unsigned int count) {
+    //Chosen on first use and reused for the rest of the run
+    static const SolveFn kernel = selectKernel();
+    kernel(meanAnomaly, eccentricity, semiMajor, semiMinor, outX, outY, count);
+}
+
+const char* OrbitKernel::getKernelName() {
+    if (kernelName == nullptr) {
+        solveKepler(nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, 0);
+    }
+    return kernelName;
+}
@@ -0,0 +1,28 @@
+#ifndef ORBITKERNEL_H
+#define ORBITKERNEL_H
+
+//Batched Kepler-equation solver.
+//For each body, takes the mean anomaly M (wrapped to [-pi, pi]) and eccentricity e, solves
+//M = E - e sin E for the eccentric anomaly E with a fixed number of Newton iterations, and
+//writes the position in the orbit's own plane, relative to the focus:
+//  x = a (cos E - e), y = b sin E
+//A fixed count means no data-dependent loop, so whole SIMD lanes finish together.
+//The AVX2 or SSE2 path is picked once at runtime, with a portable scalar fallback.
+class OrbitKernel {
+private:
+	typedef void (*SolveFn)(const float* meanAnomaly, const float* eccentricity, const float* semiMajor, const float* semiMinor, float* outX, float* outY, unsigned int count);
+	static SolveFn selectKernel();
+	static const char* kernelName;
+public:
+	//Enough for float precision up to MAX_ECCENTRICITY from the starting guesses used
+	static const unsigned int KEPLER_ITERATIONS = 5;
+	static constexpr float MAX_ECCENTRICITY = 0.95f;
+	static void solveKepler(const float* meanAnomaly, const float* eccentricity, const float* semiMajor, const float* semiMinor, float* outX, float* outY, unsigned int count);
+	static void solveKeplerScalar(const float* meanAnomaly, const float* eccentricity, const float* semiMajor, const float* semiMinor, float* outX, float* outY, unsigned int count);
+	//Polynomial sincos used by every path. Max error is about 1e-7 for |x| <= pi
+	static void sinCos(float x, float& s, float& c);
+	//"avx2", "sse2" or "scalar"
+	static const char* getKernelName();
+};
+
+#endif
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include "Profiler.h"
+
+std::mutex Profiler::registryMutex;
+std::vector<std::unique_ptr<Profiler::ThreadBuffer>> Profiler::buffers;
+std::atomic<bool> Profiler::enabled(true);
+std::vector<float> Profiler::frameTimes;
+unsigned int Profiler::frameCount = 0;
+thread_local Profiler::ThreadBuffer* Profiler::threadBuffer = nullptr;
+Profiler::ThreadBuffer* Profiler::gpuBuffer = nullptr;
+
+//Trace timestamps count from here
+static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+int64_t Profiler::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+Profiler::Scope::Scope(const char* name) {
+    this->name = name;
+    start = enabled ? now() : -1;
+}
+
+Profiler::Scope::~Scope() {
+    if (start >= 0) {
+        push(localBuffer(), name, start, now() - start);
+    }
+}
+
+Profiler::ThreadBuffer& Profiler::addBuffer(const std::string& name) {
+    //Buffers live until exit so a trace can still be written after their thread has finished
+    std::lock_guard<std::mutex> lock(registryMutex);
+    buffers.emplace_back(new ThreadBuffer());
+    ThreadBuffer& buffer = *buffers.back();
+    buffer.id = buffers.size();
+    buffer.name = name.empty() ? "thread " + std::to_string(buffer.id) : name;
+    buffer.events.resize(RING_SIZE);
+    buffer.head = 0;
+    return buffer;
+}
+
+Profiler::ThreadBuffer& Profiler::localBuffer() {
+    if (threadBuffer == nullptr) {
+        threadBuffer = &addBuffer("");
+    }
+    return *threadBuffer;
+}
+
+void Profiler::push(ThreadBuffer& buffer, const char* name, int64_t start, int64_t duration) {
+    //Single writer: fill the slot, then publish it by moving head on
+    uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    Event& event = buffer.events[head & (RING_SIZE - 1)];
+    event.name = name;
+    event.start = start;
+    event.duration = duration;
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::setThreadName(const std::string& name) {
+    ThreadBuffer& buffer = localBuffer();
+    std::lock_guard<std::mutex> lock(registryMutex);
+    buffer.name = name;
+}
+
+void Profiler::record(const char* name, int64_t start, int64_t duration) {
+    if (enabled) {
+        push(localBuffer(), name, start, duration);
+    }
+}
+
+void Profiler::recordGpu(const char* name, int64_t start, int64_t duration) {
+    if (!enabled) {
+        return;
+    }
+    //Only ever called from the thread that owns the GL context, so the ring still has one writer
+    if (gpuBuffer == nullptr) {
+        gpuBuffer = &addBuffer("GPU");
+    }
+    push(*gpuBuffer, name, start, duration);
+}
+
+void Profiler::endFrame(float frameMilliseconds) {
+    if (frameTimes.size() < FRAME_WINDOW) {
+        frameTimes.push_back(frameMilliseconds);
+    }
+    else {
+        frameTimes[frameCount % FRAME_WINDOW] = frameMilliseconds;
+    }
+    ++frameCount;
+}
+
+float Profiler::getFramePercentile(float percentile) {
+    if (frameTimes.empty()) {
+        return 0.0f;
+    }
+    std::vector<float> sorted = frameTimes;
+    unsigned int rank = std::min((unsigned int)sorted.size() - 1, (unsigned int)(percentile / 100.0f * sorted.size()));
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+static std::string escapeJson(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+bool Profiler::writeChromeTrace(const std::string& path) {
+    std::ofstream file(path);
+    if (!file) {
+        std::cout << "Failed to write trace " << path << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    char line[512];
+    unsigned long long written = 0;
+    for (const std::unique_ptr<ThreadBuffer>& buffer : buffers) {
+        file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id
+             << ",\"args\":{\"name\":\"" << escapeJson(buffer->name) << "\"}}";
+        first = false;
+
+        //The owner keeps recording while this copies, so anything it may have overwritten meanwhile is dropped
+        uint64_t end = buffer->head.load(std::memory_order_acquire);
+        uint64_t begin = end > RING_SIZE ? end - RING_SIZE : 0;
+        std::vector<Event> events;
+        events.reserve(end - begin);
+        for (uint64_t i = begin; i < end; ++i) {
+            events.push_back(buffer->events[i & (RING_SIZE - 1)]);
+        }
+        uint64_t after = buffer->head.load(std::memory_order_acquire);
+        uint64_t skip = after > RING_SIZE + begin ? std::min(after - RING_SIZE - begin + 1, (uint64_t)events.size()) : 0;
+
+        for (uint64_t i = skip; i < events.size(); ++i) {
+            const Event& event = events[i];
+            std::snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                          escapeJson(event.name).c_str(), buffer->id, event.start / 1000.0, event.duration / 1000.0);
+            file << line;
+            ++written;
+        }
+    }
+    file << "\n]}\n";
+    std::cout << "Wrote " << written << " trace events to " << path << std::endl;
+    return (bool)file;
+}
@@ -0,0 +1,86 @@
+#include<glad.h>
+#include<GLFW/glfw3.h>
+#include <cstring>
+
+#include "ShaderProgram.h"
+
+ShaderProgram::ShaderProgram(unsigned int program) {
+    this->program = program;
+    if (program != 0) {
+        resolveUniforms();
+    }
+}
+
+void ShaderProgram::resolveUniforms() {
+    uniforms.clear();
+
+    int count = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    for (int i = 0; i < count; ++i) {
+        char name[256];
+        int length, size;
+        unsigned int type;
+        glGetActiveUniform(program, i, sizeof(name), &length, &size, &type, name);
+        //Uniforms inside a block report -1 here; they are set through the block's buffer instead
+        int location = glGetUniformLocation(program, name);
+        if (location >= 0) {
+            uniforms[name] = Uniform{ location, {} };
+        }
+    }
+
+    //Every program that declares the shared block reads it from the same binding point
+    unsigned int blockIndex = glGetUniformBlockIndex(program, "FrameData");
+    if (blockIndex != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, blockIndex, FRAME_BLOCK_BINDING);
+    }
+}
+
+int ShaderProgram::getUniformLocation(const char* name) const {
+    auto found = uniforms.find(name);
+    return found == uniforms.end() ? -1 : found->second.location;
+}
+
+void ShaderProgram::use() const {
+    glUseProgram(program);
+}
+
+ShaderProgram::Uniform* ShaderProgram::changedUniform(const char* name, const float* values, unsigned int count) {
+    auto found = uniforms.find(name);
+    if (found == uniforms.end()) {
+        return nullptr;
+    }
+    Uniform& uniform = found->second;
+    if (uniform.lastValue.size() == count && std::memcmp(uniform.lastValue.data(), values, count * sizeof(float)) == 0) {
+        return nullptr;
+    }
+    uniform.lastValue.assign(values, values + count);
+    return &uniform;
+}
+
+//Setters assume this program is the one currently in use
+void ShaderProgram::setFloat(const char* name, float value) {
+    if (Uniform* uniform = changedUniform(name, &value, 1)) {
+        glUniform1f(uniform->location, value);
+    }
+}
+
+//Remembered as a float like the rest, which is exact for anything a shader is given here
+void ShaderProgram::setInt(const char* name, int value) {
+    float remembered = (float)value;
+    if (Uniform* uniform = changedUniform(name, &remembered, 1)) {
+        glUniform1i(uniform->location, value);
+    }
+}
+
+void ShaderProgram::setVec3(const char* name, float x, float y, float z) {
+    float values[3] = { x, y, z };
+    if (Uniform* uniform = changedUniform(name, values, 3)) {
+        glUniform3fv(uniform->location, 1, values);
+    }
+}
+
+void ShaderProgram::setMat4(const char* name, const float* matrix) {
+    if (Uniform* uniform = changedUniform(name, matrix, 16)) {
+        glUniformMatrix4fv(uniform->location, 1, GL_FALSE, matrix);
+    }
+}
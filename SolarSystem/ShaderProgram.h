@@ -0,0 +1,35 @@
+#ifndef SHADERPROGRAM_H
+#define SHADERPROGRAM_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//Wraps a linked program and resolves every active uniform location once, straight after linking.
+//Setters remember the last value sent so unchanged values are never re-uploaded.
+class ShaderProgram {
+private:
+	struct Uniform {
+		int location;
+		std::vector<float> lastValue;
+	};
+	unsigned int program;
+	std::unordered_map<std::string, Uniform> uniforms;
+	void resolveUniforms();
+	//Returns nullptr if the value is unchanged (or the uniform was optimised out)
+	Uniform* changedUniform(const char* name, const float* values, unsigned int count);
+public:
+	//Binding point shared by every program for the FrameUniforms block
+	static const unsigned int FRAME_BLOCK_BINDING = 0;
+	ShaderProgram(unsigned int program = 0);
+	unsigned int getProgram() const { return program; }
+	int getUniformLocation(const char* name) const;
+	void use() const;
+	void setFloat(const char* name, float value);
+	//Also for samplers, which take the texture unit
+	void setInt(const char* name, int value);
+	void setVec3(const char* name, float x, float y, float z);
+	void setMat4(const char* name, const float* matrix);
+};
+
+#endif
@@ -0,0 +1,356 @@
+#include<glad.h>
+#include<GLFW/glfw3.h>
+#include <iostream>
+#include <fstream>
+#include <functional>
+#include <vector>
+
+#include "ShaderRegistry.h"
+
+std::map<std::string, ShaderProgram> ShaderRegistry::programs;
+std::string ShaderRegistry::binaryCacheDirectory;
+
+//Shader source code is AI Generated.
+//Compiled twice: lit for planets and with UNLIT defined for the sun, so neither has to branch per fragment.
+static const char* bodyVertexShaderSource = R"(
+    #version 330 core
+    layout(location = 0) in vec3 aPos;
+    layout(location = 1) in vec3 aNormal;
+    //Per-instance attributes filled by InstancedRenderer: centre in xyz, radius in w
+    layout(location = 2) in vec4 instanceTransform;
+    layout(location = 3) in vec3 instanceColor;
+
+    out vec3 ObjectColor;
+#ifndef UNLIT
+    out vec3 FragPos;
+    out vec3 Normal;
+#endif
+
+    //Shared by every program, filled once per frame by FrameUniforms
+    layout(std140) uniform FrameData {
+        mat4 view;
+        mat4 projection;
+        vec4 viewPos;
+        vec4 lightPos;
+        vec4 lightColor;
+    };
+
+    void main() {
+        //Translation and uniform scale only: no model matrix to build and no normal matrix,
+        //since scaling every axis equally leaves directions alone (the fragment shader normalizes)
+        vec3 worldPos = aPos * instanceTransform.w + instanceTransform.xyz;
+        ObjectColor = instanceColor;
+#ifndef UNLIT
+        FragPos = worldPos;
+        Normal = aNormal;
+#endif
+        gl_Position = projection * view * vec4(worldPos, 1.0);
+    }
+)";
+
+static const char* bodyFragmentShaderSource = R"(
+    #version 330 core
+    out vec4 FragColor;
+
+    in vec3 ObjectColor;
+#ifndef UNLIT
+    in vec3 FragPos;
+    in vec3 Normal;
+
+    layout(std140) uniform FrameData {
+        mat4 view;
+        mat4 projection;
+        vec4 viewPos;
+        vec4 lightPos;
+        vec4 lightColor;
+    };
+#endif
+
+    void main() {
+#ifdef UNLIT
+        FragColor = vec4(ObjectColor, 1.0);
+#else
+        float ambientStrength = 0.3;
+        vec3 ambient = ambientStrength * lightColor.rgb;
+
+        vec3 norm = normalize(Normal);
+        vec3 lightDir = normalize(lightPos.xyz - FragPos);
+        float diff = max(dot(norm, lightDir), 0.0);
+        vec3 diffuse = diff * lightColor.rgb;
+
+        float specularStrength = 0.8;
+        vec3 viewDir = normalize(viewPos.xyz - FragPos);
+        vec3 reflectDir = reflect(-lightDir, norm);
+        float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+        vec3 specular = specularStrength * spec * lightColor.rgb;
+
+        vec3 result = (ambient + diffuse + specular) * ObjectColor;
+        FragColor = vec4(result, 1.0);
+#endif
+    }
+)";
+
+static const char* pointVertexShaderSource = R"(
+    #version 330 core
+    layout(location = 0) in vec3 aPos;
+    layout(location = 1) in vec3 aColor;
+
+    out vec3 ObjectColor;
+
+    layout(std140) uniform FrameData {
+        mat4 view;
+        mat4 projection;
+        vec4 viewPos;
+        vec4 lightPos;
+        vec4 lightColor;
+    };
+
+    void main() {
+        ObjectColor = aColor;
+        gl_Position = projection * view * vec4(aPos, 1.0);
+    }
+)";
+
+static const char* pointFragmentShaderSource = R"(
+    #version 330 core
+    out vec4 FragColor;
+
+    in vec3 ObjectColor;
+
+    void main() {
+        FragColor = vec4(ObjectColor, 1.0);
+    }
+)";
+
+//Trail vertices are bare positions in per-body rings laid out by TrailRenderer; the body, and how many
+//appends ago the point was recorded, come from where the vertex sits in the buffer
+static const char* trailVertexShaderSource = R"(
+    #version 330 core
+    layout(location = 0) in vec3 aPos;
+
+    out vec3 TrailColor;
+
+    layout(std140) uniform FrameData {
+        mat4 view;
+        mat4 projection;
+        vec4 viewPos;
+        vec4 lightPos;
+        vec4 lightColor;
+    };
+
+    //One colour per body
+    uniform samplerBuffer colors;
+    //Newest slot, vertices per ring, slots per ring (the last vertex mirrors slot 0) and points drawn
+    uniform int head;
+    uniform int stride;
+    uniform int capacity;
+    uniform float trailLength;
+    uniform vec3 background;
+
+    void main() {
+        int body = gl_VertexID / stride;
+        int slot = gl_VertexID - body * stride;
+        if (slot == capacity) {
+            slot = 0;
+        }
+        float age = float((head - slot + capacity) % capacity);
+        TrailColor = mix(background, texelFetch(colors, body).rgb, 1.0 - age / trailLength);
+        gl_Position = projection * view * vec4(aPos, 1.0);
+    }
+)";
+
+static const char* trailFragmentShaderSource = R"(
+    #version 330 core
+    out vec4 FragColor;
+
+    in vec3 TrailColor;
+
+    void main() {
+        FragColor = vec4(TrailColor, 1.0);
+    }
+)";
+
+unsigned int ShaderRegistry::compileShader(unsigned int type, const char* source) {
+    unsigned int shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+
+    int success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        char infoLog[512];
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::" << type << "::COMPILATION_FAILED\n" << infoLog << std::endl;
+    }
+
+    return shader;
+}
+
+unsigned int ShaderRegistry::linkProgram(const char* vertexSource, const char* fragmentSource) {
+    unsigned int vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource);
+    unsigned int fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
+
+    unsigned int shaderProgram = glCreateProgram();
+    glAttachShader(shaderProgram, vertexShader);
+    glAttachShader(shaderProgram, fragmentShader);
+#if defined(GL_VERSION_4_1) || defined(GL_ARB_get_program_binary)
+    if (binaryCacheSupported()) {
+        glProgramParameteri(shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+#endif
+    glLinkProgram(shaderProgram);
+
+    int success;
+    // check for linking errors
+    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    }
+
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+    return shaderProgram;
+}
+
+bool ShaderRegistry::binaryCacheSupported() {
+#if defined(GL_VERSION_4_1) || defined(GL_ARB_get_program_binary)
+    if (binaryCacheDirectory.empty() || !(GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_get_program_binary)) {
+        return false;
+    }
+    //Some drivers expose the entry points but no binary formats
+    int formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    return formatCount > 0;
+#else
+    return false;
+#endif
+}
+
+std::string ShaderRegistry::binaryCachePath(const std::string& name, const char* vertexSource, const char* fragmentSource) {
+    //Binaries are only valid for the exact driver that produced them, and for the exact sources
+    std::string key = std::string(vertexSource) + fragmentSource;
+    key += (const char*)glGetString(GL_VENDOR);
+    key += (const char*)glGetString(GL_RENDERER);
+    key += (const char*)glGetString(GL_VERSION);
+    return binaryCacheDirectory + "/" + name + "_" + std::to_string(std::hash<std::string>()(key)) + ".bin";
+}
+
+unsigned int ShaderRegistry::loadBinary(const std::string& path) {
+#if defined(GL_VERSION_4_1) || defined(GL_ARB_get_program_binary)
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return 0;
+    }
+    unsigned int format;
+    file.read((char*)&format, sizeof(format));
+    std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (!file.eof() || binary.empty()) {
+        return 0;
+    }
+
+    unsigned int program = glCreateProgram();
+    glProgramBinary(program, format, binary.data(), binary.size());
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        //Stale or rejected by the driver, fall back to compiling from source
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+#else
+    return 0;
+#endif
+}
+
+void ShaderRegistry::saveBinary(const std::string& path, unsigned int program) {
+#if defined(GL_VERSION_4_1) || defined(GL_ARB_get_program_binary)
+    int length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    std::vector<char> binary(length);
+    unsigned int format;
+    glGetProgramBinary(program, length, NULL, &format, binary.data());
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cout << "Failed to write shader cache " << path << std::endl;
+        return;
+    }
+    file.write((const char*)&format, sizeof(format));
+    file.write(binary.data(), binary.size());
+#endif
+}
+
+void ShaderRegistry::setBinaryCacheDirectory(const std::string& directory) {
+    binaryCacheDirectory = directory;
+}
+
+std::string ShaderRegistry::withDefines(const char* source, const std::vector<std::string>& defines) {
+    //#version has to stay the first statement, so the defines go on the line after it
+    std::string expanded = source;
+    std::size_t version = expanded.find("#version");
+    std::size_t insertAt = version == std::string::npos ? 0 : expanded.find('\n', version);
+    insertAt = insertAt == std::string::npos ? expanded.size() : insertAt + 1;
+    std::string lines;
+    for (const std::string& define : defines) {
+        lines += "#define " + define + "\n";
+    }
+    return expanded.insert(insertAt, lines);
+}
+
+ShaderProgram& ShaderRegistry::get(const std::string& name, const char* vertexSource, const char* fragmentSource, const std::vector<std::string>& defines) {
+    auto found = programs.find(name);
+    if (found != programs.end()) {
+        return found->second;
+    }
+    if (!defines.empty()) {
+        std::string vertexVariant = withDefines(vertexSource, defines);
+        std::string fragmentVariant = withDefines(fragmentSource, defines);
+        return get(name, vertexVariant.c_str(), fragmentVariant.c_str());
+    }
+
+    unsigned int program = 0;
+    bool useCache = binaryCacheSupported();
+    std::string path;
+    if (useCache) {
+        path = binaryCachePath(name, vertexSource, fragmentSource);
+        program = loadBinary(path);
+    }
+    if (program == 0) {
+        program = linkProgram(vertexSource, fragmentSource);
+        if (useCache) {
+            saveBinary(path, program);
+        }
+    }
+
+    return programs.emplace(name, ShaderProgram(program)).first->second;
+}
+
+ShaderProgram& ShaderRegistry::getBodyShader() {
+    return get("body", bodyVertexShaderSource, bodyFragmentShaderSource);
+}
+
+ShaderProgram& ShaderRegistry::getSunShader() {
+    return get("body_unlit", bodyVertexShaderSource, bodyFragmentShaderSource, { "UNLIT" });
+}
+
+ShaderProgram& ShaderRegistry::getPointShader() {
+    return get("point", pointVertexShaderSource, pointFragmentShaderSource);
+}
+
+ShaderProgram& ShaderRegistry::getTrailShader() {
+    return get("trail", trailVertexShaderSource, trailFragmentShaderSource);
+}
+
+void ShaderRegistry::clear() {
+    for (auto& entry : programs) {
+        glDeleteProgram(entry.second.getProgram());
+    }
+    programs.clear();
+}
@@ -0,0 +1,40 @@
+#ifndef SHADERREGISTRY_H
+#define SHADERREGISTRY_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "ShaderProgram.h"
+
+//Compiles each named program once and hands the same ShaderProgram to everything that asks for it.
+//If a cache directory is set, linked programs are saved with glGetProgramBinary and reloaded
+//with glProgramBinary on the next run, skipping GLSL compilation entirely.
+class ShaderRegistry {
+private:
+	static std::map<std::string, ShaderProgram> programs;
+	static std::string binaryCacheDirectory;
+	static unsigned int compileShader(unsigned int type, const char* source);
+	static unsigned int linkProgram(const char* vertexSource, const char* fragmentSource);
+	static bool binaryCacheSupported();
+	static std::string binaryCachePath(const std::string& name, const char* vertexSource, const char* fragmentSource);
+	static unsigned int loadBinary(const std::string& path);
+	static void saveBinary(const std::string& path, unsigned int program);
+	static std::string withDefines(const char* source, const std::vector<std::string>& defines);
+public:
+	//Empty (the default) disables the on-disk cache
+	static void setBinaryCacheDirectory(const std::string& directory);
+	//Each define is added as "#define X" straight after #version, so one source can build several variants.
+	//The name identifies the variant and must differ between variants of the same source.
+	static ShaderProgram& get(const std::string& name, const char* vertexSource, const char* fragmentSource, const std::vector<std::string>& defines = {});
+	//The lit/instanced program every planet and moon is drawn with
+	static ShaderProgram& getBodyShader();
+	//The same program compiled with UNLIT for stars: flat colour, no lighting
+	static ShaderProgram& getSunShader();
+	//Unlit single-pixel points for bodies culled down to impostors
+	static ShaderProgram& getPointShader();
+	//Orbit trails from TrailRenderer, fading with age
+	static ShaderProgram& getTrailShader();
+	static void clear();
+};
+
+#endif
@@ -0,0 +1,276 @@
+#include <cmath>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include "Simulation.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+
+//Distances are scene units and time is in seconds, so G is picked to give the earth's
+//orbit (radius 149.87) one radian per second around the sun's real mass
+static const double SUN_MASS_KG = 1.989e30;
+static const double EARTH_ORBIT_RADIUS = 149.87;
+static const double SCENE_G = EARTH_ORBIT_RADIUS * EARTH_ORBIT_RADIUS * EARTH_ORBIT_RADIUS / SUN_MASS_KG;
+
+Simulation::Simulation() : gravity(SCENE_G, 1.0 / 240.0) {
+    mode = KINEMATIC;
+    gravitySeeded = false;
+    time = 0.0;
+    frontBuffer = 0;
+    fixedStep = gravity.getFixedStep();
+    accumulator = 0.0;
+    timeWarp = 1.0;
+    stepBudget = 0.0;
+    lastStepCount = 0;
+    stepCount = 0;
+    interpolate = false;
+    detectCollisions = false;
+}
+
+unsigned int Simulation::addBody(int parent, float orbitRadius, float angularSpeed, float bodyRadius, double bodyMassKg, Color bodyColor, bool isStar, float startAngle, OrbitShape shape) {
+    unsigned int id = bodies.addBody(parent, orbitRadius, angularSpeed, startAngle, shape);
+    massKg.push_back(bodyMassKg);
+    radius.push_back(bodyRadius);
+    color.push_back(bodyColor);
+    star.push_back(isStar ? 1 : 0);
+    gravitySeeded = false;
+    return id;
+}
+
+unsigned int Simulation::appendBodies(unsigned int count, const int* parents, const float* orbitRadii, const float* angularSpeeds, const float* startAngles,
+    const float* bodyRadii, const double* bodyMassesKg, const Color* bodyColors, const unsigned char* flags, const OrbitShape* shapes) {
+    unsigned int first = bodies.appendBodies(count, parents, orbitRadii, angularSpeeds, startAngles, shapes);
+    massKg.insert(massKg.end(), bodyMassesKg, bodyMassesKg + count);
+    radius.insert(radius.end(), bodyRadii, bodyRadii + count);
+    color.insert(color.end(), bodyColors, bodyColors + count);
+    star.resize(first + count);
+    for (unsigned int i = 0; i < count; ++i) {
+        star[first + i] = flags[i] & 1;
+    }
+    gravitySeeded = false;
+    return first;
+}
+
+void Simulation::reserve(unsigned int count) {
+    bodies.reserve(count);
+    massKg.reserve(count);
+    radius.reserve(count);
+    color.reserve(count);
+    star.reserve(count);
+}
+
+void Simulation::loadSolarSystem() {
+    int sunDiameter = 100;
+    //Sun's radius is 109x that of earth
+    int sun = addBody(-1, 0, 0, sunDiameter, SUN_MASS_KG, Color{ 1.0f, 0.65f, 0.0f }, true);     //Orange
+    addBody(sun, 19.3 + sunDiameter, 4.15f, 1.0f, 3.30e23, Color{ 0.72f, 0.73f, 0.74f });         //Mercury
+    addBody(sun, 36.06 + sunDiameter, 1.62f, 2.82f, 4.87e24, Color{ 0.57f, 0.52f, 0.56f });       //Venus
+    int earth = addBody(sun, 49.87 + sunDiameter, 1.0f, 3.0f, 5.97e24, Color{ 0, 0, 0.9f });     //Earth
+    addBody(earth, 3.84, 13, 0.75f, 7.35e22, Color{ 0.62f, 0.63f, 0.64f });                       //Moon
+    addBody(sun, 76 + sunDiameter, 0.53f, 1.6f, 6.42e23, Color{ 0.63f, 0.14f, 0.1f });            //Mars
+    addBody(sun, 259 + sunDiameter, 0.084f, 32.87f, 1.898e27, Color{ 0.79f, 0.56f, 0.22f });      //Jupiter
+    addBody(sun, 475.6 + sunDiameter, 0.034f, 28.33f, 5.68e26, Color{ 0.77f, 0.69f, 0.55f });     //Saturn
+    addBody(sun, 957 + sunDiameter, 0.012f, 7.47f, 8.68e25, Color{ 0.82f, 0.9f, 0.9f });          //Uranus
+    addBody(sun, 1499 + sunDiameter, 0.006f, 11.6f, 1.02e26, Color{ 0.15f, 0.27f, 0.53f });       //Neptune
+
+    //Places everything without moving it
+    bodies.setTime(time);
+}
+
+void Simulation::addAsteroidBelt(int parent, unsigned int count, float innerRadius, float outerRadius, unsigned int seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> radiusDistribution(innerRadius, outerRadius);
+    std::uniform_real_distribution<float> angleDistribution(0.0f, 6.2831853f);
+    std::uniform_real_distribution<float> greyDistribution(0.35f, 0.6f);
+    //Roughly the spread of the real main belt
+    std::uniform_real_distribution<float> eccentricityDistribution(0.0f, 0.25f);
+    std::uniform_real_distribution<float> inclinationDistribution(0.0f, 0.2f);
+
+    reserve(size() + count);
+    for (unsigned int i = 0; i < count; ++i) {
+        float r = radiusDistribution(random);
+        float speed = (float)std::pow(EARTH_ORBIT_RADIUS / r, 1.5);
+        float grey = greyDistribution(random);
+        OrbitShape shape;
+        shape.eccentricity = eccentricityDistribution(random);
+        shape.inclination = inclinationDistribution(random);
+        shape.ascendingNode = angleDistribution(random);
+        shape.argumentOfPeriapsis = angleDistribution(random);
+        addBody(parent, r, speed, 0.2f, 1e15, Color{ grey, grey, grey }, false, angleDistribution(random), shape);
+    }
+    bodies.setTime(time);
+}
+
+//Every body gets its current kinematic position, and a velocity along its kinematic orbit with the
+//speed gravity needs for that orbit's shape; parents first so their velocity can be added on
+void Simulation::seedGravity() {
+    gravity.clear();
+    gravity.reserve(size());
+    for (unsigned int id = 0; id < size(); ++id) {
+        gravity.addBody(massKg[id], bodies.getPos(id), Vector3{ 0, 0, 0 });
+    }
+    bodies.getLevelCount();
+    for (unsigned int slot = 0; slot < size(); ++slot) {
+        unsigned int id = bodies.getBodyAtSlot(slot);
+        int parent = bodies.getParent(id);
+        if (parent >= 0) {
+            gravity.setOrbitVelocity(id, parent, bodies.getOrbitalVelocity(id), bodies.getOrbitRadius(id));
+        }
+    }
+    gravitySeeded = true;
+}
+
+void Simulation::setMode(Mode newMode) {
+    if (newMode == GRAVITY && mode != GRAVITY) {
+        //Starts from wherever the kinematic orbits had got to
+        gravitySeeded = false;
+    }
+    mode = newMode;
+}
+
+void Simulation::setTimeWarp(double warp) {
+    timeWarp = std::min(MAX_TIME_WARP, std::max(MIN_TIME_WARP, warp));
+}
+
+void Simulation::seek(double newTime) {
+    time = newTime;
+    accumulator = 0.0;
+    bodies.setTime(newTime);
+    if (mode == GRAVITY) {
+        seedGravity();
+    }
+    else {
+        gravitySeeded = false;
+    }
+    //Nothing to blend from across a jump, and nothing to sweep across it either
+    previous.clear();
+    collisions.reset();
+}
+
+void Simulation::setCollisionDetection(bool enabled) {
+    detectCollisions = enabled;
+    if (!enabled) {
+        collisions.reset();
+    }
+}
+
+void Simulation::checkCollisions(double stepTime) {
+    collisionPositions.resize(size());
+    JobSystem::parallelFor(size(), COPY_CHUNK, [this](unsigned int begin, unsigned int end) {
+        for (unsigned int id = begin; id < end; ++id) {
+            collisionPositions[id] = getPos(id);
+        }
+    });
+    collisions.update(collisionPositions.data(), radius.data(), size(), stepTime);
+}
+
+void Simulation::snapshotPrevious() {
+    previous.resize(size());
+    JobSystem::parallelFor(size(), COPY_CHUNK, [this](unsigned int begin, unsigned int end) {
+        for (unsigned int id = begin; id < end; ++id) {
+            previous[id] = getPos(id);
+        }
+    });
+}
+
+unsigned int Simulation::runSteps(unsigned int count) {
+    PROFILE_SCOPE("fixed steps");
+    if (mode == KINEMATIC && !detectCollisions) {
+        //Orbits are evaluated in closed form, so any backlog of steps costs one evaluation;
+        //the time one step earlier is evaluated too to leave a previous state to interpolate from
+        double target = time + count * fixedStep;
+        if (interpolate) {
+            bodies.setTime(target - fixedStep);
+            snapshotPrevious();
+        }
+        bodies.setTime(target);
+        return count;
+    }
+
+    //Gravity has to take every step. So do orbits being checked for collisions, since the detector
+    //treats motion between checks as a straight line and a backlog could span whole orbits.
+    //Each step is spread over the job system, and the budget is checked between steps so a huge
+    //warp cannot stall the frame. Any step may turn out to be the last, so each one saves the state
+    //before it for publish() to blend from
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int done = 0; done < count; ++done) {
+        if (stepBudget > 0.0 && done > 0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > stepBudget) {
+            return done;
+        }
+        if (interpolate) {
+            snapshotPrevious();
+        }
+        double stepTime = time + (done + 1) * fixedStep;
+        if (mode == KINEMATIC) {
+            bodies.setTime(stepTime);
+        }
+        else {
+            gravity.step();
+        }
+        if (detectCollisions) {
+            checkCollisions(stepTime);
+        }
+    }
+    return count;
+}
+
+void Simulation::advance(float deltaTime) {
+    if (mode == GRAVITY && !gravitySeeded) {
+        seedGravity();
+    }
+
+    accumulator += deltaTime * timeWarp;
+    double wanted = std::floor(accumulator / fixedStep);
+    //Unchecked orbits can take any backlog in one go; stepping could never catch up with more than this
+    unsigned int count = (unsigned int)std::min(wanted, mode == KINEMATIC && !detectCollisions ? 4e9 : 1e7);
+    lastStepCount = count > 0 ? runSteps(count) : 0;
+    if (lastStepCount < wanted) {
+        //Out of budget: drop the backlog (keeping the fraction of a step) rather than fall further behind
+        accumulator = std::fmod(accumulator, fixedStep);
+    }
+    else {
+        accumulator -= lastStepCount * fixedStep;
+    }
+    time += lastStepCount * fixedStep;
+    stepCount += lastStepCount;
+}
+
+void Simulation::step(unsigned int count) {
+    if (mode == GRAVITY && !gravitySeeded) {
+        seedGravity();
+    }
+    double budget = stepBudget;
+    stepBudget = 0.0;
+    lastStepCount = count > 0 ? runSteps(count) : 0;
+    stepBudget = budget;
+    time += lastStepCount * fixedStep;
+    stepCount += lastStepCount;
+}
+
+void Simulation::publish() {
+    PROFILE_SCOPE("publish");
+    std::vector<Vector3>& back = published[1 - frontBuffer];
+    back.resize(size());
+    if (!interpolate || previous.size() != size()) {
+        JobSystem::parallelFor(size(), COPY_CHUNK, [this, &back](unsigned int begin, unsigned int end) {
+            for (unsigned int id = begin; id < end; ++id) {
+                back[id] = getPos(id);
+            }
+        });
+        return;
+    }
+
+    //How far the leftover time has got through the next step
+    float alpha = (float)std::min(1.0, accumulator / fixedStep);
+    JobSystem::parallelFor(size(), COPY_CHUNK, [this, &back, alpha](unsigned int begin, unsigned int end) {
+        for (unsigned int id = begin; id < end; ++id) {
+            Vector3 from = previous[id];
+            Vector3 to = getPos(id);
+            back[id] = Vector3{ from.x + (to.x - from.x) * alpha, from.y + (to.y - from.y) * alpha, from.z + (to.z - from.z) * alpha };
+        }
+    });
+}
+
+void Simulation::swapPublished() {
+    frontBuffer = 1 - frontBuffer;
+}
@@ -0,0 +1,127 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <vector>
+#include "BodyTypes.h"
+#include "BodyStore.h"
+#include "GravitySystem.h"
+#include "CollisionDetector.h"
+
+//The simulation core: every body, its physical properties and how it moves.
+//Has no OpenGL/GLFW dependency so it can run headless (see HeadlessMain.cpp);
+//the Window just reads positions out of it each frame.
+//
+//Body ids are the same in every mode, so getPos(i) always refers to the same body.
+class Simulation {
+public:
+	enum Mode {
+		KINEMATIC,	//Circular orbits from BodyStore
+		GRAVITY		//N-body integration from GravitySystem, seeded from the current orbits
+	};
+private:
+	BodyStore bodies;
+	GravitySystem gravity;
+	std::vector<double> massKg;
+	std::vector<float> radius;
+	std::vector<Color> color;
+	std::vector<unsigned char> star;
+	Mode mode;
+	bool gravitySeeded;
+	double time;
+	//Fixed-step clock: frame time times the warp goes into the accumulator and whole steps come out
+	double fixedStep;
+	double accumulator;
+	double timeWarp;
+	//Wall-clock seconds one advance() may spend stepping; 0 means no limit
+	double stepBudget;
+	unsigned int lastStepCount;
+	//Fixed steps run since the start, across every mode
+	unsigned long long stepCount;
+	//Positions before the last fixed step, so the renderer can blend towards the current ones
+	bool interpolate;
+	std::vector<Vector3> previous;
+	//Positions handed to the renderer. advance() + publish() fill the back buffer while
+	//the renderer reads the front one, so a step can overlap drawing the previous frame.
+	std::vector<Vector3> published[2];
+	unsigned int frontBuffer;
+	//Close approaches and collisions, checked after every fixed step when enabled
+	bool detectCollisions;
+	CollisionDetector collisions;
+	std::vector<Vector3> collisionPositions;
+	void seedGravity();
+	void checkCollisions(double stepTime);
+	void snapshotPrevious();
+	//Steps the current mode by count fixed steps; returns how many it managed within the budget
+	unsigned int runSteps(unsigned int count);
+	//Saves and restores every field above
+	friend class Snapshot;
+public:
+	Simulation();
+	//parent is the id of the body to orbit, or -1 for the origin. orbitRadius is the semi-major axis,
+	//angularSpeed the mean motion in radians per second and startAngle the mean anomaly now.
+	//Returns the new body's id.
+	unsigned int addBody(int parent, float orbitRadius, float angularSpeed, float bodyRadius, double bodyMassKg, Color bodyColor, bool isStar = false, float startAngle = 0.0f, OrbitShape shape = OrbitShape());
+	//Bulk version of addBody used by the catalog loader; every array holds count values.
+	//Parent ids are relative to the first appended body. flags bit 0 marks a star; shapes may be null for circles.
+	//Returns the id of the first appended body.
+	unsigned int appendBodies(unsigned int count, const int* parents, const float* orbitRadii, const float* angularSpeeds, const float* startAngles,
+		const float* bodyRadii, const double* bodyMassesKg, const Color* bodyColors, const unsigned char* flags, const OrbitShape* shapes = nullptr);
+	void reserve(unsigned int count);
+	//The sun, the eight planets and the moon, in scene units
+	void loadSolarSystem();
+	//Adds count small bodies orbiting `parent` between the two radii, for stress testing.
+	//Angular speeds follow Kepler's third law relative to the earth's orbit; the orbits are
+	//mildly eccentric and inclined like the real main belt.
+	void addAsteroidBelt(int parent, unsigned int count, float innerRadius, float outerRadius, unsigned int seed);
+	void setMode(Mode newMode);
+	//Moves the clock on by deltaTime * timeWarp, in whole fixed steps; the remainder carries over
+	void advance(float deltaTime);
+	//Runs exactly count fixed steps, whatever the time warp and step budget; the remainder is left alone
+	void step(unsigned int count);
+	//Simulated seconds per real second, clamped to [MIN_TIME_WARP, MAX_TIME_WARP]
+	void setTimeWarp(double warp);
+	//Jumps straight to an absolute time. Kinematic orbits are evaluated there directly;
+	//gravity is re-seeded from them, since an N-body state can only be stepped to
+	void seek(double newTime);
+	void setStepBudget(double seconds) { stepBudget = seconds; }
+	//Keeps the positions from before the last step so publish() can interpolate
+	void setInterpolation(bool enabled) { interpolate = enabled; }
+	//Copies the current positions (interpolated if enabled) into the back buffer
+	void publish();
+	//Makes the last published positions the front buffer; nothing may be publishing at the time
+	void swapPublished();
+	//Runs the collision detector after every fixed step. Kinematic orbits then give up evaluating a
+	//backlog in one go and are evaluated at every step too, under the same step budget as gravity
+	void setCollisionDetection(bool enabled);
+	bool isDetectingCollisions() const { return detectCollisions; }
+	CollisionDetector& getCollisions() { return collisions; }
+	//Appends the close approaches and collisions since the last call
+	void takeCollisionEvents(std::vector<CollisionEvent>& out) { collisions.takeEvents(out); }
+
+	static constexpr double MIN_TIME_WARP = 1.0;
+	static constexpr double MAX_TIME_WARP = 1e6;
+	//Bodies per job when positions are copied out (to publish, interpolate or check for collisions)
+	static const unsigned int COPY_CHUNK = 16384;
+
+	Mode getMode() const { return mode; }
+	double getTimeWarp() const { return timeWarp; }
+	double getFixedStep() const { return fixedStep; }
+	unsigned int getLastStepCount() const { return lastStepCount; }
+	unsigned long long getStepCount() const { return stepCount; }
+	double getTime() const { return time; }
+	unsigned int size() const { return massKg.size(); }
+	Vector3 getPos(unsigned int id) const { return mode == GRAVITY ? gravity.getPos(id) : bodies.getPos(id); }
+	float getRadius(unsigned int id) const { return radius[id]; }
+	double getMassKg(unsigned int id) const { return massKg[id]; }
+	Color getColor(unsigned int id) const { return color[id]; }
+	bool isStar(unsigned int id) const { return star[id] != 0; }
+	const std::vector<unsigned char>& getStarFlags() const { return star; }
+	const std::vector<float>& getRadii() const { return radius; }
+	const std::vector<Color>& getColors() const { return color; }
+	const std::vector<Vector3>& getPublished() const { return published[frontBuffer]; }
+	BodyStore& getBodies() { return bodies; }
+	const BodyStore& getBodies() const { return bodies; }
+	GravitySystem& getGravity() { return gravity; }
+};
+
+#endif
@@ -0,0 +1,194 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include "Snapshot.h"
+
+static const char SNAPSHOT_MAGIC[8] = { 'S', 'S', 'S', 'N', 'A', 'P', '\0', '\0' };
+
+//Each array is its byte length followed by the raw elements
+template <typename T>
+static void writeArray(std::ofstream& file, const std::vector<T>& values) {
+    uint64_t bytes = values.size() * sizeof(T);
+    file.write((const char*)&bytes, sizeof(bytes));
+    file.write((const char*)values.data(), bytes);
+}
+
+//remaining is what is left of the file, so a corrupt length fails here rather than in resize()
+template <typename T>
+static bool readArray(std::ifstream& file, std::vector<T>& values, uint64_t& remaining) {
+    uint64_t bytes = 0;
+    if (remaining < sizeof(bytes) || !file.read((char*)&bytes, sizeof(bytes))) {
+        return false;
+    }
+    remaining -= sizeof(bytes);
+    if (bytes % sizeof(T) != 0 || bytes > remaining) {
+        return false;
+    }
+    remaining -= bytes;
+    values.resize(bytes / sizeof(T));
+    return (bool)file.read((char*)values.data(), bytes);
+}
+
+//Calls visit with the same array of every simulation given, in file order
+template <typename Visit, typename... Sims>
+bool Snapshot::visitArrays(Visit&& visit, Sims&... simulations) {
+    return visit(simulations.bodies.epochAnomaly...) && visit(simulations.bodies.angularSpeed...) && visit(simulations.bodies.orbitRadius...)
+        && visit(simulations.bodies.eccentricity...) && visit(simulations.bodies.semiMinor...)
+        && visit(simulations.bodies.axisPX...) && visit(simulations.bodies.axisPY...) && visit(simulations.bodies.axisPZ...)
+        && visit(simulations.bodies.axisQX...) && visit(simulations.bodies.axisQY...) && visit(simulations.bodies.axisQZ...)
+        && visit(simulations.bodies.angle...) && visit(simulations.bodies.parent...)
+        && visit(simulations.bodies.posX...) && visit(simulations.bodies.posY...) && visit(simulations.bodies.posZ...)
+        && visit(simulations.bodies.parentBody...) && visit(simulations.bodies.shapes...) && visit(simulations.bodies.slotOfBody...)
+        && visit(simulations.bodies.bodyOfSlot...) && visit(simulations.bodies.levelStart...)
+        && visit(simulations.gravity.posX...) && visit(simulations.gravity.posY...) && visit(simulations.gravity.posZ...)
+        && visit(simulations.gravity.velX...) && visit(simulations.gravity.velY...) && visit(simulations.gravity.velZ...)
+        && visit(simulations.gravity.accX...) && visit(simulations.gravity.accY...) && visit(simulations.gravity.accZ...)
+        && visit(simulations.gravity.mass...)
+        && visit(simulations.massKg...) && visit(simulations.radius...) && visit(simulations.color...) && visit(simulations.star...)
+        && visit(simulations.previous...) && visit(simulations.published[0]...) && visit(simulations.published[1]...);
+}
+
+//Every array has to fit the header's body count, and every index in them has to point at a body
+bool Snapshot::isConsistent(const SnapshotHeader& header, const Simulation& simulation) {
+    unsigned int count = header.count;
+    bool seeded = (header.flags & 1) != 0;
+    if (header.mode > Simulation::GRAVITY || header.solver > GravitySystem::BARNES_HUT || header.frontBuffer > 1) {
+        return false;
+    }
+    const BodyStore& bodies = simulation.bodies;
+    const GravitySystem& gravity = simulation.gravity;
+    //Per-body arrays are exactly count long; the N-body and position buffers may also be empty
+    bool sized = true;
+    auto exact = [&sized, count](const auto& values) { sized = sized && values.size() == count; };
+    auto optional = [&sized, count](const auto& values) { sized = sized && (values.empty() || values.size() == count); };
+    exact(bodies.epochAnomaly); exact(bodies.angularSpeed); exact(bodies.orbitRadius);
+    exact(bodies.eccentricity); exact(bodies.semiMinor);
+    exact(bodies.axisPX); exact(bodies.axisPY); exact(bodies.axisPZ);
+    exact(bodies.axisQX); exact(bodies.axisQY); exact(bodies.axisQZ);
+    exact(bodies.angle); exact(bodies.parent);
+    exact(bodies.posX); exact(bodies.posY); exact(bodies.posZ);
+    exact(bodies.parentBody); exact(bodies.shapes); exact(bodies.slotOfBody); exact(bodies.bodyOfSlot);
+    exact(simulation.massKg); exact(simulation.radius); exact(simulation.color); exact(simulation.star);
+    optional(simulation.previous); optional(simulation.published[0]); optional(simulation.published[1]);
+    unsigned int gravityCount = gravity.mass.size();
+    if (!sized || (gravityCount != 0 && gravityCount != count) || (seeded && gravityCount != count)) {
+        return false;
+    }
+    for (const std::vector<double>* values : { &gravity.posX, &gravity.posY, &gravity.posZ, &gravity.velX, &gravity.velY, &gravity.velZ,
+        &gravity.accX, &gravity.accY, &gravity.accZ }) {
+        if (values->size() != gravityCount) {
+            return false;
+        }
+    }
+
+    for (unsigned int i = 0; i < count; ++i) {
+        if (bodies.slotOfBody[i] >= count || bodies.bodyOfSlot[i] >= count || bodies.parent[i] < -1 || bodies.parent[i] >= (int)count
+            || bodies.parentBody[i] < -1 || bodies.parentBody[i] >= (int)count) {
+            return false;
+        }
+    }
+    //Levels are slot ranges from 0; a clean store's last one ends at count, a dirty one is rebuilt before use
+    const std::vector<unsigned int>& levelStart = bodies.levelStart;
+    if (levelStart.empty() || levelStart[0] != 0 || ((header.flags & 8) == 0 && levelStart.back() != count)) {
+        return false;
+    }
+    for (unsigned int l = 1; l < levelStart.size(); ++l) {
+        if (levelStart[l] < levelStart[l - 1] || levelStart[l] > count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Snapshot::save(const Simulation& simulation, const std::string& path) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cout << "Failed to write snapshot " << path << std::endl;
+        return false;
+    }
+
+    const BodyStore& bodies = simulation.bodies;
+    const GravitySystem& gravity = simulation.gravity;
+    SnapshotHeader header = {};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = VERSION;
+    header.count = simulation.size();
+    header.mode = simulation.mode;
+    header.flags = (simulation.gravitySeeded ? 1 : 0) | (simulation.interpolate ? 2 : 0)
+        | (gravity.accelerationsValid ? 4 : 0) | (bodies.levelsDirty ? 8 : 0);
+    header.solver = gravity.solver;
+    header.frontBuffer = simulation.frontBuffer;
+    header.time = simulation.time;
+    header.accumulator = simulation.accumulator;
+    header.timeWarp = simulation.timeWarp;
+    header.stepBudget = simulation.stepBudget;
+    header.bodyTime = bodies.time;
+    header.theta = gravity.tree.getTheta();
+    header.stepCount = simulation.stepCount;
+    file.write((const char*)&header, sizeof(header));
+
+    visitArrays([&file](const auto& values) {
+        writeArray(file, values);
+        return true;
+    }, simulation);
+    return (bool)file;
+}
+
+bool Snapshot::load(Simulation& simulation, const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    SnapshotHeader header;
+    if (!file || !file.read((char*)&header, sizeof(header)) || std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        std::cout << "Not a snapshot: " << path << std::endl;
+        return false;
+    }
+    if (header.version != VERSION) {
+        std::cout << "Unsupported snapshot version " << header.version << " in " << path << std::endl;
+        return false;
+    }
+
+    //Read into a scratch simulation and only moved into place once all of it checks out,
+    //so a bad file leaves simulation as it was
+    file.seekg(0, std::ios::end);
+    uint64_t remaining = (uint64_t)file.tellg() - sizeof(header);
+    file.seekg(sizeof(header));
+    Simulation loaded;
+    bool complete = visitArrays([&file, &remaining](auto& values) {
+        return readArray(file, values, remaining);
+    }, loaded);
+    if (!complete || !isConsistent(header, loaded)) {
+        std::cout << "Snapshot " << path << " is truncated or corrupt" << std::endl;
+        return false;
+    }
+    visitArrays([](auto& target, auto& source) {
+        target.swap(source);
+        return true;
+    }, simulation, loaded);
+
+    BodyStore& bodies = simulation.bodies;
+    GravitySystem& gravity = simulation.gravity;
+    simulation.mode = (Simulation::Mode)header.mode;
+    simulation.gravitySeeded = (header.flags & 1) != 0;
+    simulation.interpolate = (header.flags & 2) != 0;
+    gravity.accelerationsValid = (header.flags & 4) != 0;
+    bodies.levelsDirty = (header.flags & 8) != 0;
+    gravity.solver = (GravitySystem::ForceSolver)header.solver;
+    gravity.tree.setTheta(header.theta);
+    simulation.frontBuffer = header.frontBuffer;
+    simulation.time = header.time;
+    simulation.accumulator = header.accumulator;
+    simulation.timeWarp = header.timeWarp;
+    simulation.stepBudget = header.stepBudget;
+    simulation.stepCount = header.stepCount;
+    simulation.lastStepCount = 0;
+    bodies.time = header.bodyTime;
+    //Encounters are events, not state: the detector starts again from the restored positions
+    simulation.collisions.reset();
+    return true;
+}
+
+bool Snapshot::isSnapshot(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    char magic[sizeof(SNAPSHOT_MAGIC)] = {};
+    return file.read(magic, sizeof(magic)) && std::memcmp(magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0;
+}
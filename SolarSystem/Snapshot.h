@@ -0,0 +1,50 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+#include <string>
+#include "Simulation.h"
+
+//Checkpoints the complete state of a Simulation to a binary file and restores it bit for bit,
+//so a long run can stop and carry on later exactly as if it had never stopped.
+//
+//Unlike a Catalog, which only describes the bodies, a snapshot holds everything that affects
+//the next step: the orbit elements as stored (not re-derived), the clock and its accumulator,
+//the N-body positions, velocities and accelerations, and the positions kept for interpolation.
+//The file is a SnapshotHeader followed by length-prefixed arrays in a fixed order.
+//Snapshots are only meant to be read back by the same build on the same kind of machine.
+class Snapshot {
+public:
+	struct SnapshotHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t count;
+		uint32_t mode;
+		uint32_t flags;				//bit 0 gravity seeded, 1 interpolation, 2 accelerations valid, 3 BodyStore levels dirty
+		uint32_t solver;
+		uint32_t frontBuffer;
+		double time;
+		double accumulator;
+		double timeWarp;
+		double stepBudget;
+		double bodyTime;
+		double theta;
+		uint64_t stepCount;
+	};
+	static const uint32_t VERSION = 1;
+private:
+	//Calls visit on every saved array in file order, so save and load cannot drift apart.
+	//Given several simulations, visit gets the same array of each
+	template <typename Visit, typename... Sims>
+	static bool visitArrays(Visit&& visit, Sims&... simulations);
+	//Whether arrays just read fit the header: sizes, indices and enum values
+	static bool isConsistent(const SnapshotHeader& header, const Simulation& simulation);
+public:
+	static bool save(const Simulation& simulation, const std::string& path);
+	//Replaces everything in simulation with the snapshot's state
+	static bool load(Simulation& simulation, const std::string& path);
+	//True when path starts with the snapshot magic (so it can share a command line slot with catalogs)
+	static bool isSnapshot(const std::string& path);
+};
+
+#endif
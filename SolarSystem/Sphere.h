@@ -2,42 +2,37 @@
 #define SPHERE_H
 
 #include<vector>
+#include "BodyTypes.h"
+#include "MeshCache.h"
 
-struct Color {
-	float r, g, b;
-};
-
-struct Vector3 {
-	float x, y, z;
-};
+//How one body is drawn. Where it is comes from the Simulation each frame.
 
 class Sphere {
 private:
-	const char* vertexShaderSource;
-	const char* fragmentShaderSource;
-	unsigned int vertexShader;
-	unsigned int fragmentShader;
-	unsigned int shaderProgram;
-	unsigned int VAO, VBO, EBO;
-	void makeShaderProgram();
-	unsigned int compileShader(unsigned int type, const char* source);
-	float massKg;
+	//Shared with every other body using the same tessellation (owned by MeshCache)
+	const Mesh* mesh;
+	float sphereRadius;
 	Color color;
 protected:
 	Vector3 pos;
 public:
 	//Not used initialiser list here so that other things can happen in the constructor
-	Sphere(float x = 0, float y = 0, float z = 0, float massKg = 0);
-	void generateSphere(std::vector<float>& vertices, std::vector<unsigned int>& indices, unsigned int latDivisions, unsigned int longDivisions, float radius);
-	void setupBuffers(const std::vector<float>& vertices, const std::vector<unsigned int>& indices);
-	void setupUniforms(bool isSun = false);
+	Sphere(float x = 0, float y = 0, float z = 0);
+	//Radius is applied through the model matrix so the mesh itself can be shared
+	void setMesh(unsigned int latDivisions, unsigned int longDivisions, float radius);
+	//Switches to another shared mesh (a different level of detail), keeping the radius
+	void setMesh(const Mesh* newMesh) { mesh = newMesh; }
 	void translate(float dx, float dy, float dz, float deltaTime);
 	//Getter methods are here to improve performance
-	unsigned int getShaderProgram() const { return shaderProgram; }
-	unsigned int getVAO() const { return VAO; }
+	unsigned int getVAO() const { return mesh->VAO; }
+	unsigned int getIndexCount() const { return mesh->indexCount; }
+	const Mesh* getMesh() const { return mesh; }
+	float getRadius() const { return sphereRadius; }
+	Color getColor() const { return color; }
 	Vector3 getPos() const { return pos; }
 	//Setter methods:
 	void setColor(float r, float g, float b);
+	void setPos(Vector3 newPos) { pos = newPos; }
 };
 
 
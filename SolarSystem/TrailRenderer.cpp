@@ -0,0 +1,221 @@
+#include<glad.h>
+#include<GLFW/glfw3.h>
+#include <algorithm>
+#include <climits>
+#include <iostream>
+
+#include "TrailRenderer.h"
+#include "JobSystem.h"
+
+bool TrailRenderer::create(const Color* colors, unsigned int bodies, unsigned int length, unsigned int decimation) {
+    clear();
+    if (bodies == 0 || length < 2) {
+        return false;
+    }
+    this->bodies = bodies;
+    this->length = length;
+    this->decimation = std::max(1u, decimation);
+    capacity = length + FRAMES_IN_FLIGHT;
+    stride = capacity + 1;
+    //glMultiDrawArrays takes the first vertex of each strip as a GLint
+    if ((unsigned long long)bodies * stride > INT_MAX) {
+        std::cout << "Trails of " << length << " points for " << bodies << " bodies are too many vertices" << std::endl;
+        return false;
+    }
+    //The first append goes into slot 0
+    head = capacity - 1;
+    filled = 0;
+    appendCount = 0;
+    frameCount = 0;
+    stalls = 0;
+
+    GLsizeiptr bytes = (GLsizeiptr)bodies * stride * 3 * sizeof(float);
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+#if defined(GL_VERSION_4_4) || defined(GL_ARB_buffer_storage)
+    if (GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage) {
+        //Coherent, so writes through the mapping are seen by any draw issued after them without a flush
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, bytes, NULL, flags);
+        mapped = (float*)glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, flags);
+        if (mapped == nullptr) {
+            //Storage is immutable, so the fallback needs a fresh buffer
+            glDeleteBuffers(1, &VBO);
+            glGenBuffers(1, &VBO);
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        }
+    }
+#endif
+    if (mapped == nullptr) {
+        glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_DYNAMIC_DRAW);
+    }
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    //Colours never change, so they are uploaded once into a buffer texture the shader indexes by body
+    std::vector<float> rgba((size_t)bodies * 4);
+    for (unsigned int i = 0; i < bodies; ++i) {
+        rgba[i * 4] = colors[i].r;
+        rgba[i * 4 + 1] = colors[i].g;
+        rgba[i * 4 + 2] = colors[i].b;
+        rgba[i * 4 + 3] = 1.0f;
+    }
+    glGenBuffers(1, &colorBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, colorBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, rgba.size() * sizeof(float), rgba.data(), GL_STATIC_DRAW);
+    glGenTextures(1, &colorTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, colorTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, colorBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    fences.assign(FRAMES_IN_FLIGHT + 1, nullptr);
+    firsts.resize((size_t)bodies * 2);
+    counts.resize((size_t)bodies * 2);
+    return true;
+}
+
+//Append n writes a slot that the draws after append n - FRAMES_IN_FLIGHT - 1 (and earlier) read,
+//and that is the fence in this slot of the ring
+void TrailRenderer::waitForSlot() {
+    void*& slot = fences[appendCount % fences.size()];
+    if (slot == nullptr) {
+        return;
+    }
+    GLsync fence = (GLsync)slot;
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        ++stalls;
+        //Flushes first in case the fence has not even reached the GPU yet
+        status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+    }
+    glDeleteSync(fence);
+    slot = nullptr;
+}
+
+//vertices holds the buffer from vertex firstVertex on
+void TrailRenderer::write(float* vertices, unsigned long long firstVertex, const Vector3* positions) {
+    unsigned int slot = head;
+    unsigned int mirror = head == 0 ? capacity : 0;
+    unsigned int ringSize = stride;
+    JobSystem::parallelFor(bodies, FILL_CHUNK, [=](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; ++i) {
+            unsigned long long ring = (unsigned long long)i * ringSize;
+            float* vertex = vertices + (ring + slot - firstVertex) * 3;
+            vertex[0] = positions[i].x;
+            vertex[1] = positions[i].y;
+            vertex[2] = positions[i].z;
+            if (mirror != 0) {
+                float* copy = vertices + (ring + mirror - firstVertex) * 3;
+                copy[0] = positions[i].x;
+                copy[1] = positions[i].y;
+                copy[2] = positions[i].z;
+            }
+        }
+    });
+}
+
+void TrailRenderer::append(const Vector3* positions, unsigned int count) {
+    if (!isActive() || count < bodies || frameCount++ % decimation != 0) {
+        return;
+    }
+    //Everything drawn since the last append has read up to the current head
+    if (appendCount > 0) {
+        fences[(appendCount - 1) % fences.size()] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    head = (head + 1) % capacity;
+    waitForSlot();
+
+    if (mapped != nullptr) {
+        write(mapped, 0, positions);
+    }
+    else {
+        //Just the span from body 0's slot to the last body's. Unsynchronized is safe for the same reason
+        //the persistent mapping is, but a driver may still copy the whole span, hence only a fallback
+        unsigned long long firstVertex = head;
+        unsigned long long lastVertex = (unsigned long long)(bodies - 1) * stride + (head == 0 ? capacity : head);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        float* vertices = (float*)glMapBufferRange(GL_ARRAY_BUFFER, firstVertex * 3 * sizeof(float), (lastVertex - firstVertex + 1) * 3 * sizeof(float),
+            GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (vertices != NULL) {
+            write(vertices, firstVertex, positions);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    filled = std::min(filled + 1, length);
+    ++appendCount;
+    buildDrawLists();
+}
+
+//Every ring has the same head, so only the offsets differ between bodies
+void TrailRenderer::buildDrawLists() {
+    unsigned int start = (head + capacity - (filled - 1)) % capacity;
+    bool wraps = start > head;
+    for (unsigned int i = 0; i < bodies; ++i) {
+        int ring = (int)(i * stride);
+        firsts[i * 2] = ring + start;
+        firsts[i * 2 + 1] = ring;
+        if (wraps) {
+            //Up to and including the mirror, which is slot 0 again, then on from slot 0
+            counts[i * 2] = capacity - start + 1;
+            counts[i * 2 + 1] = head + 1;
+        }
+        else {
+            counts[i * 2] = filled;
+            counts[i * 2 + 1] = 0;
+        }
+    }
+}
+
+void TrailRenderer::draw(ShaderProgram& shader, Color background) {
+    if (!isActive() || filled < 2) {
+        return;
+    }
+    shader.use();
+    shader.setInt("colors", 0);
+    shader.setInt("head", head);
+    shader.setInt("stride", stride);
+    shader.setInt("capacity", capacity);
+    shader.setFloat("trailLength", (float)length);
+    shader.setVec3("background", background.r, background.g, background.b);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, colorTexture);
+    glBindVertexArray(VAO);
+    glMultiDrawArrays(GL_LINE_STRIP, firsts.data(), counts.data(), bodies * 2);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void TrailRenderer::clear() {
+    if (VBO == 0) {
+        return;
+    }
+    //Nothing may still be reading the buffer when it goes
+    for (void*& slot : fences) {
+        if (slot != nullptr) {
+            glClientWaitSync((GLsync)slot, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+            glDeleteSync((GLsync)slot);
+            slot = nullptr;
+        }
+    }
+    if (mapped != nullptr) {
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        mapped = nullptr;
+    }
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteTextures(1, &colorTexture);
+    glDeleteBuffers(1, &colorBuffer);
+    VAO = VBO = colorTexture = colorBuffer = 0;
+    fences.clear();
+    firsts.clear();
+    counts.clear();
+}
@@ -0,0 +1,63 @@
+#ifndef TRAILRENDERER_H
+#define TRAILRENDERER_H
+
+#include <vector>
+#include "BodyTypes.h"
+#include "ShaderProgram.h"
+
+//Orbit trails: the last few positions of each of the first few bodies, drawn as line strips that
+//fade into the background.
+//
+//Every trail is a ring of positions in one vertex buffer, body after body. An append writes only the
+//newest position of each body, one vertex each, and never re-uploads a history. With buffer storage
+//(GL 4.4 or ARB_buffer_storage) the buffer is mapped once, persistently, and written straight from
+//the job system; without it each append maps the buffer unsynchronized instead.
+//
+//The GPU may still be drawing earlier frames while a slot is rewritten, so a ring holds
+//FRAMES_IN_FLIGHT more slots than are drawn: the slot being written is outside every trail drawn
+//since the last FRAMES_IN_FLIGHT appends, and a fence per append makes sure older draws have finished.
+//Each ring also has a last vertex mirroring its first, so a trail that wraps round is two strips that
+//meet exactly, and every trail goes in one glMultiDrawArrays. The shader gets the body and the age of
+//a vertex from gl_VertexID and the colour from a buffer texture, so a vertex is only its position.
+class TrailRenderer {
+private:
+	unsigned int bodies = 0, length = 0, decimation = 1;
+	//Slots per ring (length + FRAMES_IN_FLIGHT), and vertices per ring (the slots and the mirror)
+	unsigned int capacity = 0, stride = 0;
+	//Slot of the newest position and how many slots hold one, up to length
+	unsigned int head = 0, filled = 0;
+	unsigned int VAO = 0, VBO = 0, colorBuffer = 0, colorTexture = 0;
+	//The persistent mapping, or null when each append maps the buffer itself
+	float* mapped = nullptr;
+	//GLsync per append, kept opaque so this header does not need the GL headers
+	std::vector<void*> fences;
+	unsigned long long appendCount = 0;
+	unsigned long long frameCount = 0;
+	unsigned long long stalls = 0;
+	//Two strips per body for glMultiDrawArrays, the second empty unless the trail wraps
+	std::vector<int> firsts, counts;
+	//Blocks until the draws that could read the next slot have finished
+	void waitForSlot();
+	void write(float* vertices, unsigned long long firstVertex, const Vector3* positions);
+	void buildDrawLists();
+public:
+	static const unsigned int FRAMES_IN_FLIGHT = 3;
+	//Bodies per append job
+	static const unsigned int FILL_CHUNK = 4096;
+	//Needs a current OpenGL context. Trails bodies 0 .. bodies - 1, each length positions long and
+	//taking a position every decimation frames
+	bool create(const Color* colors, unsigned int bodies, unsigned int length, unsigned int decimation);
+	bool isActive() const { return VBO != 0; }
+	//Call once a frame with every body's position (count of them); only every decimation-th call
+	//records them, and a call with fewer positions than trailed bodies records nothing
+	void append(const Vector3* positions, unsigned int count);
+	//Expects the FrameUniforms block uploaded. background is what a trail fades into
+	void draw(ShaderProgram& shader, Color background);
+	unsigned int getBodies() const { return bodies; }
+	unsigned long long getStalls() const { return stalls; }
+	bool isPersistent() const { return mapped != nullptr; }
+	//Waits for the GPU and frees the GL objects; needs the context, so call it before the window goes
+	void clear();
+};
+
+#endif
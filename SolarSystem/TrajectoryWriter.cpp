@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include "TrajectoryWriter.h"
+#include "JobSystem.h"
+
+static const char TRAJECTORY_MAGIC[8] = { 'S', 'S', 'T', 'R', 'A', 'J', '\0', '\0' };
+
+TrajectoryWriter::~TrajectoryWriter() {
+    close();
+}
+
+bool TrajectoryWriter::open(const std::string& path, unsigned int bodyCount, unsigned int recordInterval, unsigned int framesPerChunk, bool compress) {
+    close();
+    file.open(path, std::ios::binary);
+    if (!file) {
+        std::cout << "Failed to write trajectory " << path << std::endl;
+        return false;
+    }
+    this->path = path;
+    header = {};
+    std::memcpy(header.magic, TRAJECTORY_MAGIC, sizeof(TRAJECTORY_MAGIC));
+    header.version = VERSION;
+    header.bodyCount = bodyCount;
+    header.recordInterval = recordInterval > 0 ? recordInterval : 1;
+    header.framesPerChunk = framesPerChunk > 0 ? framesPerChunk : 1;
+    header.compressed = compress ? 1 : 0;
+    file.write((const char*)&header, sizeof(header));
+
+    for (Chunk& chunk : chunks) {
+        chunk.times.resize(header.framesPerChunk);
+        chunk.steps.resize(header.framesPerChunk);
+        chunk.positions.resize((size_t)header.framesPerChunk * bodyCount * 3);
+        chunk.frames = 0;
+    }
+    filling = 0;
+    writerBusy = false;
+    closing = false;
+    framesRecorded = 0;
+    bytesWritten = sizeof(header);
+    stalls = 0;
+    thread = std::thread(&TrajectoryWriter::writerLoop, this);
+    return true;
+}
+
+void TrajectoryWriter::record(const Simulation& simulation) {
+    if (!isOpen()) {
+        return;
+    }
+    unsigned long long step = simulation.getStepCount();
+    if (framesRecorded > 0 && step - lastRecordedStep < header.recordInterval) {
+        return;
+    }
+
+    Chunk& chunk = chunks[filling];
+    unsigned int count = std::min(header.bodyCount, simulation.size());
+    float* out = chunk.positions.data() + (size_t)chunk.frames * header.bodyCount * 3;
+    JobSystem::parallelFor(count, RECORD_CHUNK, [&simulation, out](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; ++i) {
+            Vector3 pos = simulation.getPos(i);
+            out[i * 3] = pos.x;
+            out[i * 3 + 1] = pos.y;
+            out[i * 3 + 2] = pos.z;
+        }
+    });
+    chunk.times[chunk.frames] = simulation.getTime();
+    chunk.steps[chunk.frames] = step;
+    ++chunk.frames;
+    ++framesRecorded;
+    lastRecordedStep = step;
+
+    if (chunk.frames == header.framesPerChunk) {
+        hand();
+    }
+}
+
+//Gives the chunk being filled to the writer thread and starts filling the other one
+void TrajectoryWriter::hand() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (writerBusy) {
+        ++stalls;
+        changed.wait(lock, [this]() { return !writerBusy; });
+    }
+    writerBusy = true;
+    filling = 1 - filling;
+    chunks[filling].frames = 0;
+    changed.notify_all();
+}
+
+void TrajectoryWriter::writerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        changed.wait(lock, [this]() { return writerBusy || closing; });
+        if (writerBusy) {
+            //hand() cannot swap again until this one is written, so the other chunk is ours
+            const Chunk& chunk = chunks[1 - filling];
+            lock.unlock();
+            writeChunk(chunk);
+            lock.lock();
+            writerBusy = false;
+            changed.notify_all();
+        }
+        else {
+            return;
+        }
+    }
+}
+
+void TrajectoryWriter::writeChunk(const Chunk& chunk) {
+    ChunkHeader chunkHeader = {};
+    chunkHeader.frameCount = chunk.frames;
+    size_t rawBytes = (size_t)chunk.frames * header.bodyCount * 3 * sizeof(float);
+    if (header.compressed) {
+        compress(chunk.positions.data(), chunk.frames, header.bodyCount * 3, encoded);
+    }
+    //Noisy data can come out of the RLE bigger than it went in; such a chunk is stored raw
+    chunkHeader.compressed = header.compressed && encoded.size() < rawBytes ? 1 : 0;
+    chunkHeader.positionBytes = chunkHeader.compressed ? encoded.size() : rawBytes;
+
+    file.write((const char*)&chunkHeader, sizeof(chunkHeader));
+    file.write((const char*)chunk.times.data(), chunk.frames * sizeof(double));
+    file.write((const char*)chunk.steps.data(), chunk.frames * sizeof(uint64_t));
+    file.write(chunkHeader.compressed ? (const char*)encoded.data() : (const char*)chunk.positions.data(), chunkHeader.positionBytes);
+    bytesWritten += sizeof(chunkHeader) + chunk.frames * (sizeof(double) + sizeof(uint64_t)) + chunkHeader.positionBytes;
+}
+
+void TrajectoryWriter::close() {
+    if (!thread.joinable()) {
+        return;
+    }
+    if (chunks[filling].frames > 0) {
+        hand();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    changed.notify_all();
+    thread.join();
+    file.close();
+    std::cout << "Wrote " << framesRecorded << " trajectory frames (" << bytesWritten << " bytes, " << stalls << " stalls) to " << path << std::endl;
+}
+
+void TrajectoryWriter::compress(const float* positions, unsigned int frames, unsigned int valuesPerFrame, std::vector<unsigned char>& out) {
+    size_t count = (size_t)frames * valuesPerFrame;
+    //Byte plane b holds byte b of every XORed value, so the mostly zero high bytes end up together
+    std::vector<unsigned char> planes(count * 4);
+    const uint32_t* bits = (const uint32_t*)positions;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t value = i >= valuesPerFrame ? bits[i] ^ bits[i - valuesPerFrame] : bits[i];
+        for (unsigned int b = 0; b < 4; ++b) {
+            planes[b * count + i] = (unsigned char)(value >> (8 * b));
+        }
+    }
+
+    //A zero byte is followed by the length of its run (1-255); everything else is literal
+    out.clear();
+    out.reserve(planes.size() / 2);
+    for (size_t i = 0; i < planes.size();) {
+        if (planes[i] != 0) {
+            out.push_back(planes[i++]);
+            continue;
+        }
+        unsigned int run = 0;
+        while (i < planes.size() && planes[i] == 0 && run < 255) {
+            ++run;
+            ++i;
+        }
+        out.push_back(0);
+        out.push_back((unsigned char)run);
+    }
+}
+
+bool TrajectoryWriter::decompress(const unsigned char* data, size_t bytes, unsigned int frames, unsigned int valuesPerFrame, float* positions) {
+    size_t count = (size_t)frames * valuesPerFrame;
+    std::vector<unsigned char> planes(count * 4);
+    size_t written = 0;
+    for (size_t i = 0; i < bytes; ++i) {
+        if (data[i] != 0) {
+            if (written == planes.size()) {
+                return false;
+            }
+            planes[written++] = data[i];
+            continue;
+        }
+        if (i + 1 == bytes || written + data[i + 1] > planes.size()) {
+            return false;
+        }
+        //planes is already zeroed
+        written += data[++i];
+    }
+    if (written != planes.size()) {
+        return false;
+    }
+
+    uint32_t* bits = (uint32_t*)positions;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t value = 0;
+        for (unsigned int b = 0; b < 4; ++b) {
+            value |= (uint32_t)planes[b * count + i] << (8 * b);
+        }
+        bits[i] = i >= valuesPerFrame ? value ^ bits[i - valuesPerFrame] : value;
+    }
+    return true;
+}
+
+bool TrajectoryWriter::read(const std::string& path, FileHeader& header, std::vector<double>& times, std::vector<uint64_t>& steps, std::vector<float>& positions) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file || !file.read((char*)&header, sizeof(header)) || std::memcmp(header.magic, TRAJECTORY_MAGIC, sizeof(TRAJECTORY_MAGIC)) != 0) {
+        std::cout << "Not a trajectory file: " << path << std::endl;
+        return false;
+    }
+    if (header.version != VERSION) {
+        std::cout << "Unsupported trajectory version " << header.version << " in " << path << std::endl;
+        return false;
+    }
+    times.clear();
+    steps.clear();
+    positions.clear();
+
+    unsigned int valuesPerFrame = header.bodyCount * 3;
+    ChunkHeader chunk;
+    std::vector<unsigned char> payload;
+    while (file.read((char*)&chunk, sizeof(chunk))) {
+        size_t firstFrame = times.size();
+        times.resize(firstFrame + chunk.frameCount);
+        steps.resize(firstFrame + chunk.frameCount);
+        positions.resize((firstFrame + chunk.frameCount) * valuesPerFrame);
+        file.read((char*)(times.data() + firstFrame), chunk.frameCount * sizeof(double));
+        file.read((char*)(steps.data() + firstFrame), chunk.frameCount * sizeof(uint64_t));
+        float* out = positions.data() + firstFrame * valuesPerFrame;
+        bool ok;
+        if (chunk.compressed) {
+            payload.resize(chunk.positionBytes);
+            ok = file.read((char*)payload.data(), payload.size()) && decompress(payload.data(), payload.size(), chunk.frameCount, valuesPerFrame, out);
+        }
+        else {
+            ok = chunk.positionBytes == (uint64_t)chunk.frameCount * valuesPerFrame * sizeof(float) && file.read((char*)out, chunk.positionBytes);
+        }
+        if (!ok) {
+            std::cout << "Trajectory " << path << " is truncated or corrupt after " << firstFrame << " frames" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
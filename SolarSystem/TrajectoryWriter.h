@@ -0,0 +1,88 @@
+#ifndef TRAJECTORYWRITER_H
+#define TRAJECTORYWRITER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Simulation.h"
+
+//Records body positions every few fixed steps into a chunked trajectory file for later analysis.
+//
+//Frames are gathered into one of two chunk buffers while a background thread writes the other,
+//so the stepping loop only ever copies positions into memory. record() waits only if a whole
+//chunk fills up before the previous one has reached the disk (counted in getStalls()).
+//
+//File: a FileHeader, then chunks, each a ChunkHeader, the frame times (double), step numbers
+//(uint64) and positions (frame by frame, body by body, x y z floats). Every chunk decodes on its
+//own. With compression on, positions are stored losslessly as the XOR of each float with the
+//same value one frame earlier, split into byte planes and run-length coded, which shrinks
+//slowly changing coordinates a lot. A chunk the coding would make bigger is stored raw instead
+//(ChunkHeader.compressed is per chunk), so compression never costs more than a few header bytes.
+class TrajectoryWriter {
+public:
+	struct FileHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t bodyCount;
+		uint32_t recordInterval;
+		uint32_t framesPerChunk;
+		uint32_t compressed;
+		uint32_t reserved;
+	};
+	struct ChunkHeader {
+		uint32_t frameCount;
+		uint32_t compressed;
+		uint64_t positionBytes;
+	};
+	static const uint32_t VERSION = 1;
+private:
+	struct Chunk {
+		std::vector<double> times;
+		std::vector<uint64_t> steps;
+		std::vector<float> positions;
+		unsigned int frames = 0;
+	};
+	std::ofstream file;
+	std::string path;
+	FileHeader header;
+	//The loop fills chunks[filling]; the other one may be with the writer thread
+	Chunk chunks[2];
+	unsigned int filling = 0;
+	bool writerBusy = false;
+	bool closing = false;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable changed;
+	unsigned long long lastRecordedStep = 0;
+	unsigned long long framesRecorded = 0, bytesWritten = 0, stalls = 0;
+	//Encoding scratch, only touched by the writer thread
+	std::vector<unsigned char> encoded;
+	void writerLoop();
+	void hand();
+	void writeChunk(const Chunk& chunk);
+public:
+	~TrajectoryWriter();
+	//Records whenever at least recordInterval fixed steps have passed since the last frame
+	bool open(const std::string& path, unsigned int bodyCount, unsigned int recordInterval, unsigned int framesPerChunk = 64, bool compress = false);
+	bool isOpen() const { return thread.joinable(); }
+	//Call after each Simulation::advance (on the same thread as the stepping)
+	void record(const Simulation& simulation);
+	//Writes the last, partly filled chunk and waits for the writer thread
+	void close();
+	unsigned long long getFramesRecorded() const { return framesRecorded; }
+	unsigned long long getStalls() const { return stalls; }
+
+	//Bodies per record job
+	static const unsigned int RECORD_CHUNK = 16384;
+
+	static void compress(const float* positions, unsigned int frames, unsigned int valuesPerFrame, std::vector<unsigned char>& out);
+	static bool decompress(const unsigned char* data, size_t bytes, unsigned int frames, unsigned int valuesPerFrame, float* positions);
+	//Reads a whole trajectory file back, for analysis and for checking the writer
+	static bool read(const std::string& path, FileHeader& header, std::vector<double>& times, std::vector<uint64_t>& steps, std::vector<float>& positions);
+};
+
+#endif
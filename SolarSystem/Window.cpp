@@ -1,12 +1,28 @@
 #include<glad.h>
 #include<GLFW/glfw3.h>
 #include<iostream>
+#include <algorithm>
 
 //The include "Window.h" must be below the other includes
 #include "Window.h"
 #include "Sphere.h"
-#include "Satellite.h"
+#include "Simulation.h"
+#include "Catalog.h"
+#include "Snapshot.h"
 #include "Camera.h"
+#include "MeshCache.h"
+#include "InstancedRenderer.h"
+#include "ShaderRegistry.h"
+#include "FrameUniforms.h"
+#include "JobSystem.h"
+#include "Culler.h"
+#include "LodSelector.h"
+#include "Profiler.h"
+#include "GpuTimers.h"
+#include "FrameCapture.h"
+#include "TrailRenderer.h"
+#include <cstdio>
+#include <gtc/type_ptr.hpp>
 
 
 void Window::initGLFW() {
@@ -16,13 +32,18 @@ void Window::initGLFW() {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    if (capture.offscreen) {
+        //Still a window (GLFW needs one for a context) but never shown; everything is drawn into the capture framebuffer.
+        //Software GL such as Mesa llvmpipe works as long as there is some display, e.g. Xvfb on a render farm node
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
 }
 
 bool Window::createWindow() {
     //Window creation
     //glfwCreateWindow returns a pointer to the memory
     //Not returning a pointer would maybe duplicate the memory required multiple times
-    window = glfwCreateWindow(WINDOWWIDTH, WINDOWHEIGHT, "Solar System", NULL, NULL);
+    window = glfwCreateWindow(capture.offscreen ? 64 : WINDOWWIDTH, capture.offscreen ? 64 : WINDOWHEIGHT, "Solar System", NULL, NULL);
     if (window == NULL) {
         std::cout << "Failed to create window" << std::endl;
         glfwTerminate();
@@ -42,7 +63,10 @@ bool Window::initGLAD() {
     return true;
 }
 
-Window::Window() {
+Window::Window(const std::string& catalogPath, const CaptureSettings& capture, const TrailSettings& trails) {
+    this->catalogPath = catalogPath;
+    this->capture = capture;
+    this->trails = trails;
     initGLFW();
     createWindow();
     initGLAD();
@@ -75,176 +99,255 @@ void Window::processInput(GLFWwindow* window, float deltaTime) {
         camera.move("backward");
     }
 
+    if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS) {
+        gravityMode = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS) {
+        gravityMode = false;
+    }
+
+    bool faster = glfwGetKey(window, GLFW_KEY_PERIOD) == GLFW_PRESS;
+    bool slower = glfwGetKey(window, GLFW_KEY_COMMA) == GLFW_PRESS;
+    if ((faster || slower) && !warpKeyHeld) {
+        timeWarp = faster ? std::min(timeWarp * 10.0, Simulation::MAX_TIME_WARP) : std::max(timeWarp / 10.0, Simulation::MIN_TIME_WARP);
+        std::cout << "Time warp: " << timeWarp << "x" << std::endl;
+    }
+    warpKeyHeld = faster || slower;
+
+    bool trace = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+    if (trace && !traceKeyHeld) {
+        Profiler::writeChromeTrace("solarsystem_trace.json");
+    }
+    traceKeyHeld = trace;
+
+    bool checkpoint = glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS;
+    if (checkpoint && !checkpointKeyHeld) {
+        checkpointRequested = true;
+    }
+    checkpointKeyHeld = checkpoint;
+
+    bool trail = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+    if (trail && !trailKeyHeld) {
+        showTrails = !showTrails;
+    }
+    trailKeyHeld = trail;
+
 }
 
 //Tried to make this stuff more efficient.
-//Don't try to make Sphere sun, Satellite earth etc into member variables
+//Don't try to make the spheres into member variables
 //Because otherwise their constructors will be called (in the header files)
 //So OpenGL will try to do the stuff in Sphere without having been initialised (here)
 void Window::render() {
-    int sunDiameter = 100;
     //Setup bodies:
-    Sphere sun(0, 0, 0, 1);
-    sun.setColor(1.0f, 0.65f, 0.0f);     //Orange
-    std::vector<float> verticesSun;
-    std::vector<unsigned int> indicesSun;
-    //Sun's radius is 109x that of earth
-    sun.generateSphere(verticesSun, indicesSun, 50, 50, sunDiameter);
-    sun.setupBuffers(verticesSun, indicesSun);
-
-    Satellite mercury(0, 0, -19.3 - sunDiameter, 1);
-    mercury.setColor(0.72f, 0.73f, 0.74f);
-    mercury.setOrbitParams(Vector3{ 0, 0, 0 }, 19.3 + sunDiameter, 4.15f);
-    std::vector<float> verticesMercury;
-    std::vector<unsigned int> indicesMercury;
-    mercury.generateSphere(verticesMercury, indicesMercury, 20, 20, 1.0f);
-    mercury.setupBuffers(verticesMercury, indicesMercury);
-
-    Satellite venus(0, 0, -36.06 - sunDiameter, 1);
-    venus.setColor(0.57f, 0.52f, 0.56f);
-    venus.setOrbitParams(Vector3{ 0, 0, 0 }, 36.06 + sunDiameter, 1.62f);
-    std::vector<float> verticesVenus;
-    std::vector<unsigned int> indicesVenus;
-    venus.generateSphere(verticesVenus, indicesVenus, 20, 20, 2.82f);
-    venus.setupBuffers(verticesVenus, indicesVenus);
-
-    Satellite earth(0, 0, -49.87 - sunDiameter, 1);
-    earth.setColor(0, 0, 0.9f);
-    earth.setOrbitParams(Vector3 {0, 0, 0}, 49.87 + sunDiameter, 1.0f);
-    std::vector<float> verticesEarth;
-    std::vector<unsigned int> indicesEarth;
-    earth.generateSphere(verticesEarth, indicesEarth, 20, 20, 3.0f);
-    earth.setupBuffers(verticesEarth, indicesEarth);
-
-    Satellite moon(0, 0, -53.71 - sunDiameter, 1);
-    moon.setColor(0.62f, 0.63f, 0.64f);
-    moon.setOrbitParams(earth.getPos(), 3.84, 13);
-    std::vector<float> verticesMoon;
-    std::vector<unsigned int> indicesMoon;
-    moon.generateSphere(verticesMoon, indicesMoon, 20, 20, 0.75f);
-    moon.setupBuffers(verticesMoon, indicesMoon);
-
-    Satellite mars(0, 0, -76 - sunDiameter, 1);
-    mars.setColor(0.63f, 0.14f, 0.1f);
-    mars.setOrbitParams(Vector3{ 0,0,0 }, 76 + sunDiameter, 0.53f);
-    std::vector<float> verticesMars;
-    std::vector<unsigned int> indicesMars;
-    mars.generateSphere(verticesMars, indicesMars, 20, 20, 1.6f);
-    mars.setupBuffers(verticesMars, indicesMars);
-
-    Satellite jupiter(0, 0, -259 - sunDiameter, 1);
-    jupiter.setColor(0.79f, 0.56f, 0.22f);
-    jupiter.setOrbitParams(Vector3{ 0, 0, 0 }, 259 + sunDiameter, 0.084f);
-    std::vector<float> verticesJupiter;
-    std::vector<unsigned int> indicesJupiter;
-    jupiter.generateSphere(verticesJupiter, indicesJupiter, 40, 40, 32.87f);
-    jupiter.setupBuffers(verticesJupiter, indicesJupiter);
-
-    Satellite saturn(0, 0, -475.6f - sunDiameter, 1);
-    saturn.setColor(0.77f, 0.69f, 0.55f);
-    saturn.setOrbitParams(Vector3{ 0, 0, 0 }, 475.6 + sunDiameter, 0.034f);
-    std::vector<float> verticesSaturn;
-    std::vector<unsigned int> indicesSaturn;
-    saturn.generateSphere(verticesSaturn, indicesSaturn, 40, 40, 28.33f);
-    saturn.setupBuffers(verticesSaturn, indicesSaturn);
-
-    Satellite uranus(0, 0, -957 - sunDiameter, 1);
-    uranus.setColor(0.82f, 0.9f, 0.9f);
-    uranus.setOrbitParams(Vector3{ 0,0,0 }, 957 + sunDiameter, 0.012f);
-    std::vector<float> verticesUranus;
-    std::vector<unsigned int> indicesUranus;
-    uranus.generateSphere(verticesUranus, indicesUranus, 20, 20, 7.47f);
-    uranus.setupBuffers(verticesUranus, indicesUranus);
-
-    Satellite neptune(0, 0, -1499 - sunDiameter, 1);
-    neptune.setColor(0.15f, 0.27f, 0.53f);
-    neptune.setOrbitParams(Vector3{ 0,0,0 }, 1499 + sunDiameter, 0.006f);
-    std::vector<float> verticesNeptune;
-    std::vector<unsigned int> indicesNeptune;
-    neptune.generateSphere(verticesNeptune, indicesNeptune, 20, 20, 11.6f);
-    neptune.setupBuffers(verticesNeptune, indicesNeptune);
-
-
-
-    glUseProgram(sun.getShaderProgram());
+    Simulation simulation;
+    if (!catalogPath.empty() && Snapshot::isSnapshot(catalogPath)) {
+        //Carries on from a checkpoint, in the mode and at the time warp it was saved with
+        if (!Snapshot::load(simulation, catalogPath)) {
+            simulation.loadSolarSystem();
+        }
+        gravityMode = simulation.getMode() == Simulation::GRAVITY;
+        timeWarp = simulation.getTimeWarp();
+    }
+    else if (catalogPath.empty() || !Catalog::load(simulation, catalogPath)) {
+        simulation.loadSolarSystem();
+    }
+
+    //One shared unit sphere per level of detail, coarse to fine
+    LodSelector lod;
+    std::vector<const Mesh*> lodMeshes(lod.getLevelCount());
+    for (unsigned int level = 0; level < lod.getLevelCount(); ++level) {
+        lodMeshes[level] = MeshCache::getSphere(lod.getDivisions(level), lod.getDivisions(level));
+    }
+
+    //Render-side view of each body; the simulation decides where they are
+    //and the LodSelector which mesh it gets each frame
+    std::vector<Sphere> spheres(simulation.size());
+    for (unsigned int i = 0; i < simulation.size(); ++i) {
+        Color color = simulation.getColor(i);
+        spheres[i].setColor(color.r, color.g, color.b);
+        spheres[i].setMesh(lod.getDivisions(0), lod.getDivisions(0), simulation.getRadius(i));
+    }
+
+    InstancedRenderer renderer;
+    //Compiled (or loaded from the binary cache) once, shared by every body
+    ShaderRegistry::setBinaryCacheDirectory(".");
+    ShaderProgram& shader = ShaderRegistry::getBodyShader();
+    ShaderProgram& sunShader = ShaderRegistry::getSunShader();
+    ShaderProgram& pointShader = ShaderRegistry::getPointShader();
+    ShaderProgram& trailShader = ShaderRegistry::getTrailShader();
+
+    //Only bodies in view and at least a pixel across get a mesh; smaller ones become points
+    Culler culler;
+    culler.setPixelThreshold(1.0f);
+    std::vector<unsigned int> visible, points;
+
+    //The light never moves, so it is uploaded once rather than every frame
+    FrameUniforms frame;
+    frame.setLight(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f));
+
+    //CPU scopes go to per-thread rings, GPU passes to their own track; P writes them out as a trace
+    Profiler::setThreadName("main");
+    GpuTimers gpuTimers;
+
+    //Frames drawn offscreen at the capture size and streamed to disk through the PBO ring
+    FrameCapture frameCapture;
+    if (!capture.output.empty()) {
+        if (!frameCapture.create(capture.width, capture.height, capture.output)) {
+            glfwTerminate();
+            std::exit(1);
+        }
+        camera.setAspect((float)capture.width / (float)capture.height);
+    }
+
+    //A ring of past positions per body on the GPU; each frame adds at most one point per body
+    TrailRenderer trailRenderer;
+    if (trails.length > 0) {
+        trailRenderer.create(simulation.getColors().data(), std::min(trails.bodies, simulation.size()), trails.length, trails.decimation);
+    }
+    const Color background = { 0.1f, 0.1f, 0.1f };
 
     glEnable(GL_DEPTH_TEST);
+    //Every sphere is closed and wound counter-clockwise from outside, so the far half never needs shading
+    glEnable(GL_CULL_FACE);
 
     float deltaTime = 0;
     float lastFrame = 0;
 
+    //Fixed steps, blended between the last two states so motion stays smooth at any frame rate.
+    //A frame may spend at most 10ms stepping, however far ahead the time warp asks for
+    simulation.setInterpolation(true);
+    simulation.setStepBudget(0.010);
+
+    //The renderer always draws the last published state while the next step runs as a job.
+    //The first state goes into the back buffer like every later one, so the swap at the top of the
+    //first frame brings it to the front and the empty buffer is never drawn
+    simulation.publish();
+    JobSystem::Counter stepDone(0);
+
     //Rendering loop
     while (!glfwWindowShouldClose(window)) {
         float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
+        deltaTime = frameCapture.isActive() ? 1.0f / CAPTURE_FRAME_RATE : currentFrame - lastFrame;
         lastFrame = currentFrame;
-        processInput(window, deltaTime);
-
-        //Bodies in Motion:
-        mercury.updateOrbit(deltaTime);
-        venus.updateOrbit(deltaTime);
-        earth.updateOrbit(deltaTime);
-        moon.setCentrePos(earth.getPos());
-        moon.updateOrbit(deltaTime);
-        mars.updateOrbit(deltaTime);
-        jupiter.updateOrbit(deltaTime);
-        saturn.updateOrbit(deltaTime);
-        uranus.updateOrbit(deltaTime);
-        neptune.updateOrbit(deltaTime);
+        Profiler::endFrame(deltaTime * 1000.0f);
+        if (Profiler::getFrameCount() % Profiler::FRAME_WINDOW == 0) {
+            char title[128];
+            std::snprintf(title, sizeof(title), "Solar System - frame p50 %.2fms, p99 %.2fms", Profiler::getFramePercentile(50.0f), Profiler::getFramePercentile(99.0f));
+            glfwSetWindowTitle(window, title);
+        }
+        PROFILE_SCOPE("frame");
+        gpuTimers.beginFrame();
+        {
+            PROFILE_SCOPE("input");
+            processInput(window, deltaTime);
+        }
+
+        //Bodies in Motion: pick up the step started last frame, then start the next one
+        //so it runs on the job system while this frame is drawn (the picture is one step behind)
+        {
+            PROFILE_SCOPE("wait for step");
+            JobSystem::wait(stepDone);
+        }
+        if (checkpointRequested) {
+            //Nothing is stepping now, so the saved state is consistent
+            Snapshot::save(simulation, "solarsystem.snap");
+            checkpointRequested = false;
+        }
+        simulation.swapPublished();
+        simulation.setMode(gravityMode ? Simulation::GRAVITY : Simulation::KINEMATIC);
+        simulation.setTimeWarp(timeWarp);
+        JobSystem::run([&simulation, deltaTime]() {
+            PROFILE_SCOPE("orbit update");
+            simulation.advance(deltaTime);
+            simulation.publish();
+        }, stepDone);
 
         //Rendering commands go here
+        if (frameCapture.isActive()) {
+            frameCapture.bind();
+        }
 
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glClearColor(background.r, background.g, background.b, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        camera.update(sun);
-
-        //All bodies:
-        sun.setupUniforms(true);
-        glBindVertexArray(sun.getVAO());
-        glDrawElements(GL_TRIANGLES, indicesSun.size(), GL_UNSIGNED_INT, 0);
-
-        mercury.setupUniforms();
-        glBindVertexArray(mercury.getVAO());
-        glDrawElements(GL_TRIANGLES, indicesMercury.size(), GL_UNSIGNED_INT, 0);
-        
-        venus.setupUniforms();
-        glBindVertexArray(venus.getVAO());
-        glDrawElements(GL_TRIANGLES, indicesVenus.size(), GL_UNSIGNED_INT, 0);
-        
-        earth.setupUniforms();
-        glBindVertexArray(earth.getVAO());
-        glDrawElements(GL_TRIANGLES, indicesEarth.size(), GL_UNSIGNED_INT, 0);
-
-        moon.setupUniforms();
-        glBindVertexArray(moon.getVAO());
-        glDrawElements(GL_TRIANGLES, indicesMoon.size(), GL_UNSIGNED_INT, 0);
-
-        mars.setupUniforms();
-        glBindVertexArray(mars.getVAO());
-        glDrawElements(GL_TRIANGLES, indicesMars.size(), GL_UNSIGNED_INT, 0);
-
-        jupiter.setupUniforms();
-        glBindVertexArray(jupiter.getVAO());
-        glDrawElements(GL_TRIANGLES, indicesJupiter.size(), GL_UNSIGNED_INT, 0);
-
-        saturn.setupUniforms();
-        glBindVertexArray(saturn.getVAO());
-        glDrawElements(GL_TRIANGLES, indicesSaturn.size(), GL_UNSIGNED_INT, 0);
-
-        uranus.setupUniforms();
-        glBindVertexArray(uranus.getVAO());
-        glDrawElements(GL_TRIANGLES, indicesUranus.size(), GL_UNSIGNED_INT, 0);
-
-        neptune.setupUniforms();
-        glBindVertexArray(neptune.getVAO());
-        glDrawElements(GL_TRIANGLES, indicesNeptune.size(), GL_UNSIGNED_INT, 0);
+        {
+            PROFILE_SCOPE("uniform upload");
+            camera.update(frame);
+            frame.upload();
+        }
+
+        //Cull, pick each survivor's level of detail, then one instanced draw per level and one draw for all the points:
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        float targetHeight = frameCapture.isActive() ? (float)frameCapture.getHeight() : (float)framebufferHeight;
+        const std::vector<Vector3>& positions = simulation.getPublished();
+        {
+            PROFILE_SCOPE("cull and lod");
+            culler.setCamera(glm::value_ptr(camera.getViewProjection()), camera.getProjectionScaleY(), targetHeight);
+            culler.cull(positions.data(), simulation.getRadii().data(), positions.size(), visible, points);
+            lod.select(positions.data(), simulation.getRadii().data(), visible, culler, positions.size());
+            const std::vector<unsigned char>& levels = lod.getLevels();
+            JobSystem::parallelFor(visible.size(), LodSelector::SELECT_CHUNK, [&](unsigned int begin, unsigned int end) {
+                for (unsigned int n = begin; n < end; ++n) {
+                    spheres[visible[n]].setMesh(lodMeshes[levels[visible[n]]]);
+                }
+            });
+        }
+
+        {
+            PROFILE_SCOPE("draw submission");
+            renderer.begin();
+            renderer.submitDrawList(spheres, positions, simulation.getStarFlags(), visible);
+            renderer.submitPoints(positions, simulation.getColors(), points);
+            gpuTimers.begin("bodies");
+            renderer.draw(shader, sunShader);
+            gpuTimers.end();
+            gpuTimers.begin("points");
+            pointShader.use();
+            renderer.drawPoints();
+            gpuTimers.end();
+        }
+
+        {
+            PROFILE_SCOPE("trails");
+            trailRenderer.append(positions.data(), positions.size());
+            if (showTrails) {
+                gpuTimers.begin("trails");
+                trailRenderer.draw(trailShader, background);
+                gpuTimers.end();
+            }
+        }
+
+        if (frameCapture.isActive()) {
+            PROFILE_SCOPE("capture");
+            frameCapture.capture();
+            if (!capture.offscreen) {
+                frameCapture.blitToScreen(framebufferWidth, framebufferHeight);
+            }
+            if (capture.frameLimit > 0 && frameCapture.getFrameCount() >= capture.frameLimit) {
+                glfwSetWindowShouldClose(window, true);
+            }
+        }
 
         //Double buffering used to load next series of pixels whilst drawing current pixels
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        {
+            PROFILE_SCOPE("swap");
+            if (!capture.offscreen) {
+                glfwSwapBuffers(window);
+            }
+            glfwPollEvents();
+        }
     }
 
+    JobSystem::wait(stepDone);
+    frameCapture.finish();
+    gpuTimers.clear();
+    trailRenderer.clear();
+    renderer.clear();
+    frame.clear();
+    ShaderRegistry::clear();
+    MeshCache::clear();
     glfwTerminate();
     std::exit(0);
 }
@@ -2,9 +2,30 @@
 #define WINDOW_H
 
 #include<GLFW/glfw3.h>
+#include <string>
 #include "Sphere.h"
 #include "Camera.h"
 
+//Offscreen rendering and frame capture, set from the command line
+struct CaptureSettings {
+	//Image sequence directory or .rgb/.raw file; empty means no capture
+	std::string output;
+	unsigned int width = 1920, height = 1080;
+	//Hidden window: frames only go to the capture output
+	bool offscreen = false;
+	//Stops after this many frames; 0 runs until the window is closed
+	unsigned int frameLimit = 0;
+};
+
+//Orbit trails, set from the command line
+struct TrailSettings {
+	//Points per trail; 0 turns trails off
+	unsigned int length = 256;
+	//A point every this many frames
+	unsigned int decimation = 2;
+	//Only the first this many bodies (the catalog's first entries) get a trail
+	unsigned int bodies = 16384;
+};
 
 class Window {
 private:
@@ -16,8 +37,27 @@ private:
 	bool initGLAD();
 	Vector3 cameraPos;
 	Camera camera;
+	//G switches to N-body gravity, K back to the kinematic circles
+	bool gravityMode = false;
+	//Period speeds the simulation up 10x, comma slows it down 10x (one change per key press)
+	double timeWarp = 1.0;
+	bool warpKeyHeld = false;
+	//P writes the profiler's trace to solarsystem_trace.json
+	bool traceKeyHeld = false;
+	//C checkpoints the simulation to solarsystem.snap once the running step has finished
+	bool checkpointKeyHeld = false;
+	bool checkpointRequested = false;
+	//T shows and hides the orbit trails; hidden trails still record, so they are whole when shown again
+	bool showTrails = true;
+	bool trailKeyHeld = false;
+	//Catalog or snapshot to start from; empty means the built-in solar system
+	std::string catalogPath;
+	CaptureSettings capture;
+	TrailSettings trails;
+	//Captured runs advance by exactly one frame at this rate, however long a frame takes to render
+	static const int CAPTURE_FRAME_RATE = 60;
 public:
-	Window();
+	Window(const std::string& catalogPath = "", const CaptureSettings& capture = CaptureSettings(), const TrailSettings& trails = TrailSettings());
 	void processInput(GLFWwindow* window, float deltaTime);
 	static void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 	void render();
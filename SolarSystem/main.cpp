@@ -1,8 +1,70 @@
-#include <Windows.h>
 #include "Window.h"
 
+#ifdef _WIN32
+#include <Windows.h>
+
+//The command line, if given, is a catalog file to load instead of the built-in solar system
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow) {
-    Window window;
+    Window window(lpCmdLine);
+
+    return 0;
+}
+#else
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+
+//Usage: solarsystem [CATALOG|SNAPSHOT] [--capture DIR|FILE.rgb] [--size WIDTHxHEIGHT] [--offscreen] [--frames N] [--trails N] [--trail-every N] [--trail-bodies N]
+int main(int argc, char** argv) {
+    std::string catalogPath;
+    CaptureSettings capture;
+    TrailSettings trails;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--capture" && hasValue) {
+            capture.output = argv[++i];
+        }
+        else if (arg == "--size" && hasValue && std::sscanf(argv[i + 1], "%ux%u", &capture.width, &capture.height) == 2) {
+            ++i;
+        }
+        else if (arg == "--offscreen") {
+            capture.offscreen = true;
+        }
+        else if (arg == "--frames" && hasValue) {
+            capture.frameLimit = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--trails" && hasValue) {
+            trails.length = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--trail-every" && hasValue) {
+            trails.decimation = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--trail-bodies" && hasValue) {
+            trails.bodies = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg.compare(0, 2, "--") != 0 && catalogPath.empty()) {
+            catalogPath = arg;
+        }
+        else {
+            std::cout << "Usage: solarsystem [CATALOG|SNAPSHOT] [--capture DIR|FILE.rgb] [--size WIDTHxHEIGHT] [--offscreen] [--frames N] [--trails N] [--trail-every N] [--trail-bodies N]" << std::endl;
+            return 1;
+        }
+    }
+    if (capture.offscreen && capture.output.empty()) {
+        std::cout << "--offscreen needs --capture to have somewhere to put the frames" << std::endl;
+        return 1;
+    }
+    if (capture.width == 0 || capture.height == 0) {
+        std::cout << "Capture size must be at least 1x1" << std::endl;
+        return 1;
+    }
+    if (trails.length == 1 || trails.decimation == 0) {
+        std::cout << "Trails need at least 2 points (or 0 for none) and --trail-every of at least 1" << std::endl;
+        return 1;
+    }
+    Window window(catalogPath, capture, trails);
 
     return 0;
 }
+#endif